@@ -161,9 +161,10 @@ AsyncEventSourceClient::AsyncEventSourceClient(AsyncWebServerRequest *request, A
 {
   _client = request->client();
   _server = server;
+  _webServer = request->server();
   _lastId = 0;
-  if(request->hasHeader("Last-Event-ID"))
-    _lastId = atoi(request->getHeader("Last-Event-ID")->value().c_str());
+  if(request->hasHeader(HDR_LAST_EVENT_ID))
+    _lastId = atoi(request->headerValue(HDR_LAST_EVENT_ID));
     
   _client->setRxTimeout(0);
   _client->onError(NULL, NULL);
@@ -200,6 +201,7 @@ void AsyncEventSourceClient::_queueMessage(AsyncEventSourceMessage *dataMessage)
 }
 
 void AsyncEventSourceClient::_onAck(size_t len, uint32_t time){
+  const bool queued = !_messageQueue.isEmpty();
   while(len && !_messageQueue.isEmpty()){
     len = _messageQueue.front()->ack(len, time);
     if(_messageQueue.front()->finished())
@@ -207,6 +209,10 @@ void AsyncEventSourceClient::_onAck(size_t len, uint32_t time){
   }
 
   _runQueue();
+  if(queued && _messageQueue.isEmpty()){
+    // Drained; the memory may let a waiting request start
+    _webServer->notifyResourcesFreed();
+  }
 }
 
 void AsyncEventSourceClient::_onPoll(){
@@ -258,7 +264,9 @@ AsyncEventSource::AsyncEventSource(const String& url)
   : _url(url)
   , _clients([](AsyncEventSourceClient *c){ delete c; })
   , _connectcb(NULL)
-{}
+{
+  addInterestingHeader(HDR_LAST_EVENT_ID);
+}
 
 AsyncEventSource::~AsyncEventSource(){
   close();
@@ -337,7 +345,6 @@ bool AsyncEventSource::canHandle(AsyncWebServerRequest *request){
   if(request->method() != HTTP_GET || !request->url().equals(_url)) {
     return false;
   }
-  request->addInterestingHeader("Last-Event-ID");
   return true;
 }
 
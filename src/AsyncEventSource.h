@@ -70,6 +70,7 @@ class AsyncEventSourceClient {
   private:
     AsyncClient *_client;
     AsyncEventSource *_server;
+    AsyncWebServer *_webServer;
     uint32_t _lastId;
     LinkedList<AsyncEventSourceMessage *> _messageQueue;
     void _queueMessage(AsyncEventSourceMessage *dataMessage);
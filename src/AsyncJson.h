@@ -181,18 +181,22 @@ protected:
 #ifndef ARDUINOJSON_5_COMPATIBILITY   
   const size_t maxJsonBufferSize;
 #endif
-  size_t _maxContentLength;
 public:
 #ifdef ARDUINOJSON_5_COMPATIBILITY      
   AsyncCallbackJsonWebHandler(const String& uri, ArJsonRequestHandlerFunction onRequest) 
-  : _uri(uri), _method(HTTP_POST|HTTP_PUT|HTTP_PATCH), _onRequest(onRequest), _maxContentLength(16384) {}
+  : _uri(uri), _method(HTTP_POST|HTTP_PUT|HTTP_PATCH), _onRequest(onRequest) {
+    setMaxContentLength(16384);
+    setRequestHeapCost(0, true);
+  }
 #else
   AsyncCallbackJsonWebHandler(const String& uri, ArJsonRequestHandlerFunction onRequest, size_t maxJsonBufferSize=DYNAMIC_JSON_DOCUMENT_SIZE) 
-  : _uri(uri), _method(HTTP_POST|HTTP_PUT|HTTP_PATCH), _onRequest(onRequest), maxJsonBufferSize(maxJsonBufferSize), _maxContentLength(16384) {}
+  : _uri(uri), _method(HTTP_POST|HTTP_PUT|HTTP_PATCH), _onRequest(onRequest), maxJsonBufferSize(maxJsonBufferSize) {
+    setMaxContentLength(16384);
+    setRequestHeapCost(maxJsonBufferSize, true);
+  }
 #endif
   
   void setMethod(WebRequestMethodComposite method){ _method = method; }
-  void setMaxContentLength(int maxContentLength){ _maxContentLength = maxContentLength; }
   void onRequest(ArJsonRequestHandlerFunction fn){ _onRequest = fn; }
 
   virtual bool canHandle(AsyncWebServerRequest *request) override final{
@@ -208,7 +212,6 @@ public:
     if ( !request->contentType().equalsIgnoreCase(JSON_MIMETYPE) )
       return false;
 
-    request->addInterestingHeader("ANY");
     return true;
   }
 
@@ -231,7 +234,7 @@ public:
           return;
         }
       }
-      request->send(_contentLength > _maxContentLength ? 413 : 400);
+      request->send((_maxContentLength && (_contentLength > _maxContentLength)) ? 413 : 400);
     } else {
       request->send(500);
     }
@@ -241,7 +244,7 @@ public:
   virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override final {
     if (_onRequest) {
       _contentLength = total;
-      if (total > 0 && request->_tempObject == NULL && total < _maxContentLength) {
+      if (total > 0 && request->_tempObject == NULL && (!_maxContentLength || total <= _maxContentLength)) {
         request->_tempObject = malloc(total);
       }
       if (request->_tempObject != NULL) {
@@ -375,6 +375,7 @@ AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebServerRequest *request, Async
 {
   _client = request->client();
   _server = server;
+  _webServer = request->server();
   _clientId = _server->_getNextId();
   _status = WS_CONNECTED;
   _pstate = 0;
@@ -401,6 +402,7 @@ AsyncWebSocketClient::~AsyncWebSocketClient(){
 
 void AsyncWebSocketClient::_onAck(size_t len, uint32_t time){
   _lastMessageTime = millis();
+  const bool queued = !_messageQueue.isEmpty();
   if(!_controlQueue.isEmpty()){
     auto head = _controlQueue.front();
     if(head->finished()){
@@ -418,6 +420,10 @@ void AsyncWebSocketClient::_onAck(size_t len, uint32_t time){
     _messageQueue.front()->ack(len, time);
   }
   _runQueue();
+  if(queued && _messageQueue.isEmpty()){
+    // Drained; the memory may let a waiting request start
+    _webServer->notifyResourcesFreed();
+  }
 }
 
 void AsyncWebSocketClient::_onPoll(){
@@ -849,6 +855,12 @@ AsyncWebSocket::AsyncWebSocket(const String& url)
   ,_enabled(true)
 {
   _eventHandler = NULL;
+  addInterestingHeader(HDR_CONNECTION);
+  addInterestingHeader(HDR_UPGRADE);
+  addInterestingHeader(HDR_ORIGIN);
+  addInterestingHeader(HDR_SEC_WEBSOCKET_VERSION);
+  addInterestingHeader(HDR_SEC_WEBSOCKET_KEY);
+  addInterestingHeader(HDR_SEC_WEBSOCKET_PROTOCOL);
 }
 
 AsyncWebSocket::~AsyncWebSocket(){}
@@ -1136,7 +1148,6 @@ void AsyncWebSocket::binaryAll(const __FlashStringHelper *message, size_t len){
 
 const char WS_STR_CONNECTION[] PROGMEM = "Connection";
 const char WS_STR_UPGRADE[] PROGMEM = "Upgrade";
-const char WS_STR_ORIGIN[] PROGMEM = "Origin";
 const char WS_STR_VERSION[] PROGMEM = "Sec-WebSocket-Version";
 const char WS_STR_KEY[] PROGMEM = "Sec-WebSocket-Key";
 const char WS_STR_PROTOCOL[] PROGMEM = "Sec-WebSocket-Protocol";
@@ -1150,36 +1161,27 @@ bool AsyncWebSocket::canHandle(AsyncWebServerRequest *request){
   if(request->method() != HTTP_GET || !request->url().equals(_url) || !request->isExpectedRequestedConnType(RCT_WS))
     return false;
 
-  request->addInterestingHeader(FPSTR(WS_STR_CONNECTION));
-  request->addInterestingHeader(FPSTR(WS_STR_UPGRADE));
-  request->addInterestingHeader(FPSTR(WS_STR_ORIGIN));
-  request->addInterestingHeader(FPSTR(WS_STR_VERSION));
-  request->addInterestingHeader(FPSTR(WS_STR_KEY));
-  request->addInterestingHeader(FPSTR(WS_STR_PROTOCOL));
   return true;
 }
 
 void AsyncWebSocket::handleRequest(AsyncWebServerRequest *request){
-  if(!request->hasHeader(FPSTR(WS_STR_VERSION)) || !request->hasHeader(FPSTR(WS_STR_KEY))){
+  if(!request->hasHeader(HDR_SEC_WEBSOCKET_VERSION) || !request->hasHeader(HDR_SEC_WEBSOCKET_KEY)){
     request->send(400);
     return;
   }
   if((_username != "" && _password != "") && !request->authenticate(_username.c_str(), _password.c_str())){
     return request->requestAuthentication();
   }
-  AsyncWebHeader* version = request->getHeader(FPSTR(WS_STR_VERSION));
-  if(version->value().toInt() != 13){
+  if(atoi(request->headerValue(HDR_SEC_WEBSOCKET_VERSION)) != 13){
     AsyncWebServerResponse *response = request->beginResponse(400);
     response->addHeader(FPSTR(WS_STR_VERSION),"13");
     request->send(response);
     return;
   }
-  AsyncWebHeader* key = request->getHeader(FPSTR(WS_STR_KEY));
-  AsyncWebServerResponse *response = new AsyncWebSocketResponse(key->value(), this);
-  if(request->hasHeader(FPSTR(WS_STR_PROTOCOL))){
-    AsyncWebHeader* protocol = request->getHeader(FPSTR(WS_STR_PROTOCOL));
+  AsyncWebServerResponse *response = new AsyncWebSocketResponse(request->headerValue(HDR_SEC_WEBSOCKET_KEY), this);
+  if(request->hasHeader(HDR_SEC_WEBSOCKET_PROTOCOL)){
     //ToDo: check protocol
-    response->addHeader(FPSTR(WS_STR_PROTOCOL), protocol->value());
+    response->addHeader(FPSTR(WS_STR_PROTOCOL), request->headerValue(HDR_SEC_WEBSOCKET_PROTOCOL));
   }
   request->send(response);
 }
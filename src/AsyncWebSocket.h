@@ -175,6 +175,7 @@ class AsyncWebSocketClient {
   private:
     AsyncClient *_client;
     AsyncWebSocket *_server;
+    AsyncWebServer *_webServer;
     uint32_t _clientId;
     AwsClientStatus _status;
 
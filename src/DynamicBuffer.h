@@ -129,7 +129,7 @@ class BufferListPrint : public Print {
             return written;
           }
         }
-        size_t to_write = std::min(_next->size() - _offset, size);
+        size_t to_write = (std::min)(_next->size() - _offset, size);
         memcpy(_next->data() + _offset, buffer, to_write);
         written += to_write;
         buffer += to_write;
@@ -189,7 +189,7 @@ class Walkable
   void reset() { _left = _right = 0; }; // Reset the walking counters
   void advance(ptrdiff_t count) { // Consume some data from the left hand side
     if (count > 0) {
-      _left = std::min(_left+count, _buf.size() - _right);
+      _left = (std::min)(_left+count, _buf.size() - _right);
     } else {
       if (abs(count) <= _left) {
         _left += count;
@@ -200,7 +200,7 @@ class Walkable
   }
   void radvance(ptrdiff_t count) {  // Consume some data from the right hand side
     if (count > 0) {
-      _right = std::min(_right+count, _buf.size() - _left);
+      _right = (std::min)(_right+count, _buf.size() - _left);
     } else {
       if (abs(count) <= _right) {
         _right += count;
@@ -248,7 +248,7 @@ class BufferPrint : public Print {
   BufferPrint(buffer_type& buf) : _buf(buf), offset(0) {};
 
   size_t write(const uint8_t *buffer, size_t size) {
-    size = std::min(size, _buf.size() - offset);
+    size = (std::min)(size, _buf.size() - offset);
     memcpy(_buf.data() + offset, buffer, size);
     offset += size;
     return size;
@@ -28,6 +28,11 @@
 
 #include "StringArray.h"
 
+#include <vector>
+#include <atomic>
+#include <Ticker.h>
+#include "DynamicBuffer.h"
+
 #ifdef ESP32
 #include <WiFi.h>
 #include <AsyncTCP.h>
@@ -57,6 +62,11 @@ class AsyncWebHandler;
 class AsyncStaticWebHandler;
 class AsyncCallbackWebHandler;
 class AsyncResponseStream;
+struct AsyncWebMultipartScan;
+class AsyncWebRequestList;
+
+#include "WebRouter.h"
+#include "WebWorkerPool.h"
 
 #ifndef WEBSERVER_H
 typedef enum {
@@ -77,6 +87,33 @@ typedef enum {
 typedef uint8_t WebRequestMethodComposite;
 typedef std::function<void(void)> ArDisconnectHandler;
 
+// Request headers known to the parser; each has a fixed slot in the request
+typedef enum {
+  HDR_HOST,
+  HDR_CONNECTION,
+  HDR_CONTENT_TYPE,
+  HDR_CONTENT_LENGTH,
+  HDR_TRANSFER_ENCODING,
+  HDR_EXPECT,
+  HDR_AUTHORIZATION,
+  HDR_ACCEPT,
+  HDR_ACCEPT_ENCODING,
+  HDR_IF_NONE_MATCH,
+  HDR_IF_MODIFIED_SINCE,
+  HDR_RANGE,
+  HDR_IF_RANGE,
+  HDR_UPGRADE,
+  HDR_ORIGIN,
+  HDR_SEC_WEBSOCKET_KEY,
+  HDR_SEC_WEBSOCKET_VERSION,
+  HDR_SEC_WEBSOCKET_PROTOCOL,
+  HDR_SEC_WEBSOCKET_EXTENSIONS,
+  HDR_COOKIE,
+  HDR_LAST_EVENT_ID,
+  HDR_KNOWN_COUNT,
+  HDR_UNKNOWN = HDR_KNOWN_COUNT
+} WebRequestHeader;
+
 /*
  * PARAMETER :: Chainable object to hold GET/POST and FILE parameters
  * */
@@ -123,12 +160,48 @@ class AsyncWebHeader {
     String toString() const { return String(_name+": "+_value+"\r\n"); }
 };
 
+/*
+ * HEADER SLOT :: Location of a received header in the request head buffer; materialized on demand
+ * */
+
+struct AsyncWebHeaderSlot {
+  uint16_t name;                    // offset of the NUL-terminated name; 0 if the slot is empty
+  uint16_t value;                   // offset of the NUL-terminated value
+  mutable AsyncWebHeader* header;   // String copy, created when first asked for
+};
+
+/*
+ * HEADER FILTER :: Set of request headers worth keeping, by well-known id or by name
+ * */
+
+class AsyncWebHeaderFilter {
+  private:
+    uint32_t _ids;        // one bit per WebRequestHeader
+    StringArray _names;   // headers without an id
+    bool _all;
+  public:
+    AsyncWebHeaderFilter(): _ids(0), _names(), _all(false) {}
+    void add(WebRequestHeader id);
+    void add(const String& name);   // "ANY" keeps every header
+    void add(const AsyncWebHeaderFilter& other);
+    void addAll() { _all = true; }
+    void clear();
+    bool all() const { return _all; }
+    bool contains(WebRequestHeader id, const char* name, size_t len) const;
+};
+
 /*
  * REQUEST :: Each incoming Client is wrapped inside a Request and both live together until disconnect
  * */
 
 typedef enum { RCT_NOT_USED = -1, RCT_DEFAULT = 0, RCT_HTTP, RCT_WS, RCT_EVENT, RCT_MAX } RequestedConnectionType;
 
+// Queue priority class of a handler's requests
+typedef enum { WRP_HIGH = 0, WRP_NORMAL, WRP_LOW, WRP_MAX } WebRequestPriority;
+
+// Order in which waiting requests of one class are started
+typedef enum { WRS_FIFO = 0, WRS_SHORTEST_FIRST } WebRequestScheduling;
+
 typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
 typedef std::function<String(const String&)> AwsTemplateProcessor;
 
@@ -137,16 +210,28 @@ class AsyncWebServerRequest {
   using FS = fs::FS;
   friend class AsyncWebServer;
   friend class AsyncCallbackWebHandler;
+  friend class AsyncWebRoute;
+  friend class AsyncWebRequestList;
   private:
     AsyncClient* _client;
     AsyncWebServer* _server;
     AsyncWebHandler* _handler;
     AsyncWebServerResponse* _response;
-    StringArray _interestingHeaders;
     ArDisconnectHandler _onDisconnectfn;
 
     String _temp;
     uint8_t _parseState;
+    AsyncWebServerRequest* _queuePrev;  // links in the server's list for our queue state
+    AsyncWebServerRequest* _queueNext;
+    AsyncWebRequestList* _queueList;
+    uint32_t _remoteAddress;    // for the server's per-client accounting; the client may be gone when we are
+    uint32_t _queuedAt;         // millis() when it started waiting for the queue, never 0; 0 when not waiting
+    size_t _expectedSize;       // handler's estimate of the response size while waiting, 0 until asked
+    uint8_t _fairSkips;         // times other clients' requests were started ahead of us while we were first
+    AsyncWebWorkerJob _offloadJob;
+    std::atomic<bool> _offloaded;   // handler is running on a worker; the server finishes us when it's done
+    bool _orphaned;             // client went away while offloaded; it is kept until we are collected
+    DynamicBuffer _pipelined;   // start of the next request, received while this one is still responding
 
     uint8_t _version;
     WebRequestMethodComposite _method;
@@ -156,27 +241,51 @@ class AsyncWebServerRequest {
     String _boundary;
     String _authorization;
     RequestedConnectionType _reqconntype;
-    void _removeNotInterestingHeaders();
     bool _isDigest;
     bool _isMultipart;
     bool _isPlainPost;
     bool _expectingContinue;
+    bool _keepAlive;
+    bool _headerChecked;        // name of the current header line has been checked against the filter
+    bool _skipHeader;           // nobody wants the current header line; drop it as it arrives
+    bool _chunked;              // body has Transfer-Encoding: chunked; _contentLength stays 0
+    uint8_t _chunkState;
+    size_t _chunkLeft;          // size of the current chunk, then bytes of it still to come
     size_t _contentLength;
     size_t _parsedLength;
-
-    LinkedList<AsyncWebHeader> _headers;
+    size_t _requestCount;
+    size_t _heapStart;          // free heap and largest block when the handler started, 0 when not measuring
+    size_t _heapLow;            // lowest seen since
+    size_t _blockStart;
+    size_t _blockLow;
+
+    DynamicBuffer _head;        // request line and header lines, NUL-terminated in place
+    size_t _headLength;         // bytes of _head in use
+    size_t _lineStart;          // offset of the line being received
+    size_t _lineLength;         // bytes received of the current line, kept or not
+    size_t _headerBytes;        // bytes received of complete header lines
+    size_t _headerCount;
+    AsyncWebHeaderSlot _knownHeaders[HDR_KNOWN_COUNT];  // first occurrence of each well-known header
+    std::vector<AsyncWebHeaderSlot> _headerSlots;       // everything else, in arrival order
+    struct ParamRef {
+      uint32_t hash;                // of the name
+      const AsyncWebParameter* param;
+    };
     LinkedList<AsyncWebParameter> _params;
+    std::vector<ParamRef> _paramIndex;  // _params in order, for lookup by number or name
+    size_t _queryStart;           // offset of the raw query string in _head, decoded on first use
+    mutable size_t _queryLength;  // 0 once decoded
     LinkedList<String> _pathParams;
 
     uint8_t _multiParseState;
-    uint8_t _boundaryPosition;
+    AsyncWebMultipartScan* _multipart;   // delimiter search state, allocated with the first body bytes
     size_t _itemStartIndex;
     size_t _itemSize;
     String _itemName;
     String _itemFilename;
     String _itemType;
     String _itemValue;
-    uint8_t *_itemBuffer;
+    DynamicBuffer _itemBuffer;    // upload staging, when the handler asks for fixed size chunks
     size_t _itemBufferIndex;
     bool _itemIsFile;
 
@@ -184,25 +293,55 @@ class AsyncWebServerRequest {
     void _onAck(size_t len, uint32_t time);
     void _onError(int8_t error);
     void _onTimeout(uint32_t time);
-    void _onDisconnect();
+    bool _onDisconnect();   // false if the client must outlive this call; it is freed with us
     void _onData(void *buf, size_t len);
+    void _ackResponse(size_t len, uint32_t time);
+    void _bufferPipelined(const void *buf, size_t len);
 
     void _addParam(AsyncWebParameter);
     void _addPathParam(const char *param);
-
-    bool _parseReqHead();
-    bool _parseReqHeader();
+    void _addPathParam(const char *param, size_t len);
+
+    bool _appendHead(const char* data, size_t len);
+    int _headLimitStatus() const;
+    void _rejectHead(int code, uint32_t retryAfter = 0);
+    void _clearHeaders();
+    const AsyncWebHeaderSlot* _findHeader(const char* name) const;
+    const AsyncWebHeaderSlot* _findHeader_P(PGM_P name) const;
+    const AsyncWebHeaderSlot* _findHeader(WebRequestHeader id) const;
+    const AsyncWebHeaderSlot* _nthHeader(size_t num) const;
+    AsyncWebHeader* _materializeHeader(const AsyncWebHeaderSlot& slot) const;
+
+    bool _keepHeaderLine() const;
+    bool _parseReqHead(char* line, size_t len);
+    bool _parseReqHeader(char* line, size_t len);
     void _parseLine();
-    void _parsePlainPostChar(uint8_t data);
-    void _parseMultipartPostByte(uint8_t data, bool last);
+    void _parseBody(uint8_t* data, size_t len, bool last);
+    size_t _parseChunked(uint8_t* data, size_t len);
+    void _parsePlainPost(char* data, size_t len, bool last);
+    void _addPlainPostParam(char* pair, size_t len);
+    void _parseMultipart(uint8_t* data, size_t len);
+    void _parseMultipartHeader();
+    void _multipartData(uint8_t* data, size_t len, bool final);
+    void _uploadData(uint8_t* data, size_t len, bool final);
     void _addGetParams(const String& params);
+    void _addGetParams(const char* params, size_t len);
+    void _parseQuery() const;
+    void _clearParams();
+    const AsyncWebParameter* _findParam(const char* name, size_t len, bool any, bool post = false, bool file = false) const;
+    const AsyncWebParameter* _findParam_P(PGM_P name, bool any, bool post = false, bool file = false) const;
+    static String _urlDecode(const char* text, size_t len);
+    static size_t _urlDecodeInPlace(char* text, size_t len);
     
     void _requestReady();
+    void _sendContinue();   // invite the body of a request sent with Expect: 100-continue
+    void _setParseState(uint8_t state); // change state, moving to the matching server queue list
+    void _sampleHeap();
+    void _endSample();      // hand what the request took, and the size of its response, to its handler
     void _handleRequest();  // called when the queue permits this request to run
-
-    void _handleUploadStart();
-    void _handleUploadByte(uint8_t data, bool last);
-    void _handleUploadEnd();
+    static void _runOffloaded(void *request);  // on a worker
+    void _finishOffload(bool cancelled);  // back from a worker: send what the handler left
+    void _recycle();        // reset for the next request on a persistent connection
 
   public:
     File _tempFile;
@@ -212,6 +351,7 @@ class AsyncWebServerRequest {
     ~AsyncWebServerRequest();
 
     AsyncClient* client(){ return _client; }
+    AsyncWebServer* server() const { return _server; }
     uint8_t version() const { return _version; }
     WebRequestMethodComposite method() const { return _method; }
     const String& url() const { return _url; }
@@ -219,6 +359,7 @@ class AsyncWebServerRequest {
     const String& contentType() const { return _contentType; }
     size_t contentLength() const { return _contentLength; }
     bool multipart() const { return _isMultipart; }
+    bool keepAlive() const { return _keepAlive; }
     const __FlashStringHelper * methodToString() const;
     const __FlashStringHelper * requestedConnTypeToString() const;
     RequestedConnectionType requestedConnType() const { return _reqconntype; }
@@ -233,7 +374,7 @@ class AsyncWebServerRequest {
     void requestAuthentication(const char * realm = NULL, bool isDigest = true);
 
     void setHandler(AsyncWebHandler *handler){ _handler = handler; }
-    void addInterestingHeader(const String& name);
+    void addInterestingHeader(const String& name) __attribute__((deprecated));  // no effect; declare on the handler instead
 
     void redirect(String url);
 
@@ -267,6 +408,13 @@ class AsyncWebServerRequest {
     AsyncWebHeader* getHeader(const __FlashStringHelper * data) const;
     AsyncWebHeader* getHeader(size_t num) const;
 
+    bool hasHeader(WebRequestHeader id) const;
+    AsyncWebHeader* getHeader(WebRequestHeader id) const;
+    const char* headerValue(WebRequestHeader id) const; // value in the request buffer, or NULL; no copy is made
+
+    static WebRequestHeader headerId(const char* name, size_t len);
+    static WebRequestHeader headerId(const __FlashStringHelper * name);
+
     size_t params() const;                      // get arguments count
     bool hasParam(const String& name, bool post=false, bool file=false) const;
     bool hasParam(const __FlashStringHelper * data, bool post=false, bool file=false) const;
@@ -283,11 +431,12 @@ class AsyncWebServerRequest {
     bool hasArg(const char* name) const;         // check if argument exists
     bool hasArg(const __FlashStringHelper * data) const;         // check if F(argument) exists
 
-    const String& ASYNCWEBSERVER_REGEX_ATTRIBUTE pathArg(size_t i) const;
+    const String& pathArg(size_t i) const;     // get {param} or regex capture by number
 
     const String& header(const char* name) const;// get request header value by name
     const String& header(const __FlashStringHelper * data) const;// get request header value by F(name)    
     const String& header(size_t i) const;        // get request header value by number
+    const String& header(WebRequestHeader id) const; // get well-known request header value
     const String& headerName(size_t i) const;    // get request header name by number
     String urlDecode(const String& text) const;
 };
@@ -338,9 +487,65 @@ class AsyncWebHandler {
     ArRequestFilterFunction _filter;
     String _username;
     String _password;
+    AsyncWebHeaderFilter _interestingHeaders;
+    bool _declaredHeaders;
+    size_t _uploadChunkSize;
+    size_t _maxContentLength;
+    size_t _heapCost;
+    bool _bodyInHeap;
+    WebRequestPriority _priority;
+    size_t _learnedHeapCost;    // running estimates from measured requests; 0 until the first
+    size_t _learnedBlockCost;
+    size_t _expectedSize;
+    size_t _learnedResponseSize;
+    bool _offload;
   public:
-    AsyncWebHandler():_username(""), _password(""){}
+    static uint32_t _headerDeclarations;  // bumped whenever any handler declares a header
+    AsyncWebHandler():_username(""), _password(""), _declaredHeaders(false), _uploadChunkSize(0), _maxContentLength(0), _heapCost(0), _bodyInHeap(false), _priority(WRP_NORMAL), _learnedHeapCost(0), _learnedBlockCost(0), _expectedSize(0), _learnedResponseSize(0), _offload(false){}
     AsyncWebHandler& setFilter(ArRequestFilterFunction fn) { _filter = fn; return *this; }
+    // Size of the pieces handed to handleUpload().  0 (default) passes file data on as it arrives;
+    // otherwise every call but the final one carries a whole multiple of it, eg. a flash sector.
+    AsyncWebHandler& setUploadChunkSize(size_t size) { _uploadChunkSize = size; return *this; }
+    size_t uploadChunkSize() const { return _uploadChunkSize; }
+    // Largest request body accepted (0 for no limit).  Longer requests are refused with 413
+    // as soon as their headers are in, before 100-continue and before any of the body is read.
+    AsyncWebHandler& setMaxContentLength(size_t length) { _maxContentLength = length; return *this; }
+    size_t maxContentLength() const { return _maxContentLength; }
+    // Heap a request takes while it is handled, plus its body length if the handler keeps the body
+    // in memory.  The queue holds a request back until this much is free above requestHeapRequired.
+    AsyncWebHandler& setRequestHeapCost(size_t bytes, bool bodyInHeap = false) { _heapCost = bytes; _bodyInHeap = bodyInHeap; return *this; }
+    virtual size_t requestHeapCost(AsyncWebServerRequest *request) const;
+    // Free heap and largest free block a request took from starting the handler to the end of its
+    // response, averaged over recent requests.  The queue uses the former when it is larger than
+    // the declared cost, and holds a request back while the largest block is below the latter.
+    void _recordHeapCost(size_t heap, size_t block);
+    size_t learnedHeapCost() const { return _learnedHeapCost; }
+    size_t learnedBlockCost() const { return _learnedBlockCost; }
+    // Rough size of a response, for starting short ones first (WRS_SHORTEST_FIRST).  Without a hint,
+    // the average of recent responses is used.
+    AsyncWebHandler& setExpectedResponseSize(size_t bytes) { _expectedSize = bytes; return *this; }
+    virtual size_t expectedResponseSize(AsyncWebServerRequest *request) const;
+    void _recordResponseSize(size_t bytes);
+    // Run handleRequest() on a worker task instead of the network task, so a slow handler doesn't
+    // hold up other connections (ESP32).  The handler may build and send() a response, or call
+    // deferResponse(), but must not use the client otherwise; the response is sent from the network
+    // task once it returns, and a handler that did neither is answered with 500.  Where there are no
+    // workers, or they are busy, it runs as usual.
+    AsyncWebHandler& setOffload(bool offload = true) { _offload = offload; return *this; }
+    bool offload() const { return _offload; }
+    // Queue class of this handler's requests.  Waiting requests start in weighted turns between
+    // the classes, so higher classes go first without shutting the lower ones out.
+    AsyncWebHandler& setPriority(WebRequestPriority priority) { _priority = priority; return *this; }
+    WebRequestPriority priority() const { return _priority; }
+    // Request headers this handler and its filter read; the parser drops headers no handler declared.
+    // "ANY" asks for every header.  A handler that declares nothing at all is given every header,
+    // so filtering only starts once every handler has declared; declareNoHeaders() says it reads none.
+    AsyncWebHandler& addInterestingHeader(WebRequestHeader id);
+    AsyncWebHandler& addInterestingHeader(const String& name);
+    AsyncWebHandler& declareNoHeaders();
+    virtual void collectInterestingHeaders(AsyncWebHeaderFilter& filter) const;
+    // Handlers with a route are only asked about urls it covers
+    virtual const AsyncWebRoute* route() const { return nullptr; }
     AsyncWebHandler& setAuthentication(const char *username, const char *password){  _username = String(username);_password = String(password); return *this; };
     bool filter(AsyncWebServerRequest *request){ return _filter == NULL || _filter(request); }
     virtual ~AsyncWebHandler(){}
@@ -350,6 +555,8 @@ class AsyncWebHandler {
     virtual void handleRequest(AsyncWebServerRequest *request __attribute__((unused))){}
     virtual void handleUpload(AsyncWebServerRequest *request  __attribute__((unused)), const String& filename __attribute__((unused)), size_t index __attribute__((unused)), uint8_t *data __attribute__((unused)), size_t len __attribute__((unused)), bool final  __attribute__((unused))){}
     virtual void handleBody(AsyncWebServerRequest *request __attribute__((unused)), uint8_t *data __attribute__((unused)), size_t len __attribute__((unused)), size_t index __attribute__((unused)), size_t total __attribute__((unused))){}
+    // Called for each decoded field of a urlencoded body; return true to keep it out of the request params
+    virtual bool handleFormParam(AsyncWebServerRequest *request __attribute__((unused)), const char *name __attribute__((unused)), const char *value __attribute__((unused)), size_t len __attribute__((unused))){ return false; }
     virtual bool isRequestHandlerTrivial(){return true;}
 };
 
@@ -369,6 +576,7 @@ class AsyncWebServerResponse {
     size_t _contentLength;
     bool _sendContentLength;
     bool _chunked;
+    bool _acceptRanges;
     size_t _headLength; // size of header
     size_t _sentLength; // size of data read from source
     size_t _ackedLength; // size of data acked by client
@@ -389,6 +597,8 @@ class AsyncWebServerResponse {
     virtual bool _finished() const;
     virtual bool _failed() const;
     virtual bool _sourceValid() const;
+    bool _keepAliveSupported() const { return _sendContentLength || _chunked; } // client can find the end of the body without a close
+    size_t _bytesWritten() const { return _writtenLength; }
     virtual void _respond(AsyncWebServerRequest *request);
     virtual size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time);
 };
@@ -405,6 +615,53 @@ struct AsyncWebServerQueueLimits {
   // Heap limits  
   size_t queueHeapRequired;     // Require at least this much free heap before queuing a new request, otherwise send a 503.
   size_t requestHeapRequired;   // Require at least this much free heap before handling a new request, except if no requests are active.  
+  // Per priority class limits
+  size_t nParallelClass[WRP_MAX]; // Permit up to this number of active parallel requests of each class, within nParallel.
+  // Per client limits
+  size_t nPerClient;  // Permit up to this number of connections from one address - send 429 otherwise.
+  // Time limits
+  size_t queueWaitMax;  // Permit requests to wait this many ms to be started - send 503 with Retry-After otherwise.
+};
+
+/*
+ * Request head limit structure for Server
+ *
+ * Any value set to 0 indicates no limit.  Requests over a limit are answered with 414 (request
+ * line) or 431 (headers) and the connection is closed.  Header bytes and count include headers
+ * that are dropped because no handler wants them.
+ * */
+struct AsyncWebServerHeadLimits {
+  size_t requestLineMax;  // Longest request line, including the url and query.
+  size_t headerLineMax;   // Longest single header line.
+  size_t headerBytesMax;  // Most bytes in all header lines together.
+  size_t headerCountMax;  // Most header lines.
+};
+
+/*
+ * REQUEST LIST :: Requests sharing a queue state, linked through the requests themselves
+ *
+ * A request is on exactly one list at a time, so moving it between states needs no allocation.
+ * */
+
+class AsyncWebRequestList {
+  private:
+    AsyncWebServerRequest* _head;
+    AsyncWebServerRequest* _tail;
+    size_t _length;
+
+  public:
+    AsyncWebRequestList() : _head(nullptr), _tail(nullptr), _length(0) {}
+    AsyncWebRequestList(const AsyncWebRequestList&) = delete;
+    AsyncWebRequestList& operator=(const AsyncWebRequestList&) = delete;
+
+    AsyncWebServerRequest* front() const { return _head; }
+    static AsyncWebServerRequest* next(const AsyncWebServerRequest* request) { return request->_queueNext; }
+    size_t length() const { return _length; }
+    bool isEmpty() const { return _head == nullptr; }
+
+    void push_back(AsyncWebServerRequest* request);
+    void push_front(AsyncWebServerRequest* request);
+    void remove(AsyncWebServerRequest* request);
 };
 
 /*
@@ -414,9 +671,16 @@ struct AsyncWebServerQueueLimits {
 typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
 typedef std::function<void(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
 typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const char *name, const char *value, size_t len)> ArFormParamHandlerFunction;
 
 class AsyncWebServer {
   protected:
+    struct ClientSlot {
+      uint32_t address;
+      uint16_t connections;
+      uint16_t active;        // requests running
+    };
+
     AsyncWebServerQueueLimits _queueLimits;
     AsyncServer _server;
     LinkedList<AsyncWebRewrite*> _rewrites;
@@ -425,8 +689,40 @@ class AsyncWebServer {
 #ifdef ASYNCWEBSERVER_NEEDS_MUTEX    
     SemaphoreHandle_t  _mutex;
 #endif
-    LinkedList<AsyncWebServerRequest*> _requestQueue;
+    AsyncWebRequestList _idleRequests;      // reading a request, or between requests
+    AsyncWebRequestList _activeRequests[WRP_MAX];  // being handled or responding, or sending a body we invited
+    AsyncWebRequestList _queuedRequests[WRP_MAX];  // waiting to be handled, or for 100 Continue
+    AsyncWebRequestList _deferredRequests;  // waiting for the next pass of processQueue()
+    uint8_t _priorityCredit[WRP_MAX];       // starts left for each class in this round
+    std::vector<ClientSlot> _clientSlots;   // one per remote address with a connection
+    AsyncWebWorkerPool _workers;            // for offloaded handlers
+    uint32_t _lastStart;                    // millis() of the last start that left requests waiting, or 0
+    uint32_t _startInterval;                // average ms between starts while requests are waiting
+    uint32_t _waitLongest;                  // longest wait before starting, ms
+    size_t _shedCount;                      // requests refused for waiting too long
+    WebRequestScheduling _scheduling;
     bool _queueActive;
+    bool _queueRecheck;                     // processQueue() was called during a pass; go round again
+    std::atomic<bool> _queueDue;            // processQueue() was called off the network task; run it from there
+    std::atomic<bool> _stopping;            // being destroyed; no more passes
+    AsyncWebServerRequest* _handling;       // whose handler is running on the network task; cleared if it is deleted
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+    TaskHandle_t _networkTask;              // the one our client callbacks run on
+    std::atomic<bool> _wakePosted;          // a poll of one of our connections is on its way to the tcpip thread
+    AsyncClient* _wakeClient;               // which one, checked there before it is used
+    tcp_pcb* _wakePcb;
+#endif
+    Ticker _queueTimer;                     // backstop while requests are waiting
+    uint32_t _keepAliveTimeout;   // seconds
+    size_t _keepAliveMax;
+    AsyncWebServerHeadLimits _headLimits;
+    AsyncWebRouter _router;
+    uint32_t _routerRevision;                  // AsyncWebRoute::revision() when built
+    bool _routerStale;
+    AsyncWebHeaderFilter _interestingHeaders;  // union of the handlers' declarations
+    uint32_t _interestingHeadersVersion;       // AsyncWebHandler::_headerDeclarations when collected
+    bool _interestingHeadersStale;
+    std::vector<DynamicBuffer> _uploadBuffers; // idle upload staging buffers
     
   public:
     AsyncWebServer(IPAddress addr, uint16_t port);
@@ -470,13 +766,51 @@ class AsyncWebServer {
     void setQueueLimits(const AsyncWebServerQueueLimits& limits);
     void printStatus(Print&);  // Write queue status in human-readable format
     void processQueue();  // Consider the current queue state against the limits; may retry deferred handlers.
+                          // Called from another task, the pass is run on the network task shortly after.
+    void notifyResourcesFreed();  // Heap or other resources were released; start waiting requests that now fit.
+    void setScheduling(WebRequestScheduling scheduling);  // Order within a priority class; WRS_FIFO by default
+    WebRequestScheduling getScheduling() const { return _scheduling; };
+
+    // Persistent connections
+    void setKeepAlive(uint32_t timeout, size_t maxRequests = 0);  // Idle timeout in seconds (0 disables keep-alive), max requests per connection (0 for no limit)
+    uint32_t getKeepAliveTimeout() const { return _keepAliveTimeout; };
+    size_t getKeepAliveMax() const { return _keepAliveMax; };
+
+    // Request head limits
+    void setHeadLimits(const AsyncWebServerHeadLimits& limits);
+    const AsyncWebServerHeadLimits& getHeadLimits() const { return _headLimits; };
   
-    void _handleDisconnect(AsyncWebServerRequest *request);
+    bool _handleDisconnect(AsyncWebServerRequest *request);
     void _attachHandler(AsyncWebServerRequest *request);
     void _rewriteRequest(AsyncWebServerRequest *request);
+    const AsyncWebHeaderFilter& _getInterestingHeaders();
+    DynamicBuffer _takeUploadBuffer(size_t size);
+    void _returnUploadBuffer(DynamicBuffer&& buffer);
     
+    static size_t _heapAvailable();
+    static size_t _heapLargestBlock();
     void _dequeue(AsyncWebServerRequest *request);
+    void _updateQueue(AsyncWebServerRequest *request);
+    size_t _clientCount() const;
+    size_t _activeCount() const;
+    bool _isActiveList(const AsyncWebRequestList* list) const { return (list >= _activeRequests) && (list < _activeRequests + WRP_MAX); }
+    bool _isQueuedList(const AsyncWebRequestList* list) const { return (list >= _queuedRequests) && (list < _queuedRequests + WRP_MAX); }
+    size_t _queuedCount() const;
+    AsyncWebServerRequest* _expiredRequest(uint32_t now);
+    uint32_t _retryAfter() const;
+    uint8_t _nextPriority();
+    ClientSlot* _findClientSlot(uint32_t address);
+    AsyncWebServerRequest* _nextFair(const AsyncWebRequestList& list);
+    size_t _expectedResponseSize(AsyncWebServerRequest *request);
+    bool _offload(AsyncWebServerRequest *request);
+    void _collectOffloaded();
+    int _continueStatus(AsyncWebServerRequest *request);
     void _defer(AsyncWebServerRequest *request);
+    void _serviceQueue() { if (_queueDue.load(std::memory_order_relaxed)) processQueue(); }  // from network events
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+    void _wakeNetworkTask();
+    static void _wakeOnTcpip(void* server);
+#endif
 };
 
 class DefaultHeaders {
@@ -276,7 +276,9 @@ SPIFFSEditor::SPIFFSEditor(const fs::FS& fs, const String& username, const Strin
 ,_password(password)
 ,_authenticated(false)
 ,_startTime(0)
-{}
+{
+  addInterestingHeader(HDR_IF_MODIFIED_SINCE);
+}
 
 #ifdef ESP8266
 SPIFFSEditor::SPIFFSEditor(const String& username, const String& password, const fs::FS& fs) : SPIFFSEditor(fs, username, password) {};
@@ -313,7 +315,6 @@ bool SPIFFSEditor::canHandle(AsyncWebServerRequest *request){
         }
 #endif
       }
-      request->addInterestingHeader(F("If-Modified-Since"));
       return true;
     }
     else if(request->method() == HTTP_POST)
@@ -377,7 +378,7 @@ void SPIFFSEditor::handleRequest(AsyncWebServerRequest *request){
     }
     else {
       const char * buildTime = __DATE__ " " __TIME__ " GMT";
-      if (request->header(F("If-Modified-Since")).equals(buildTime)) {
+      if (request->header(HDR_IF_MODIFIED_SINCE).equals(buildTime)) {
         request->send(304);
       } else {
         AsyncWebServerResponse *response = request->beginResponse_P(200, FPSTR(CONTENT_TYPE_HTML), edit_htm_gz, edit_htm_gz_len);
@@ -100,6 +100,10 @@ class LinkedList {
     T& front() const {
       return _root->value();
     }
+
+    T& back() const {
+      return _last->value();
+    }
     
     bool isEmpty() const {
       return _root == nullptr;
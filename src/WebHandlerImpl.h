@@ -22,10 +22,6 @@
 #define ASYNCWEBSERVERHANDLERIMPL_H_
 
 #include <string>
-#ifdef ASYNCWEBSERVER_REGEX
-#include <regex>
-#endif
-
 #include "stddef.h"
 #include <time.h>
 
@@ -44,13 +40,16 @@ class AsyncStaticWebHandler: public AsyncWebHandler {
     String _cache_control;
     String _last_modified;
     AwsTemplateProcessor _callback;
+    AsyncWebRoute _route;
     bool _isDir;
     bool _gzipFirst;
     uint8_t _gzipStats;
   public:
     AsyncStaticWebHandler(String uri, FS& fs, String path, const char* cache_control);
     virtual bool canHandle(AsyncWebServerRequest *request) override final;
+    virtual const AsyncWebRoute* route() const override { return &_route; }
     virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    virtual size_t expectedResponseSize(AsyncWebServerRequest *request) const override;
     AsyncStaticWebHandler& setIsDir(bool isDir);
     AsyncStaticWebHandler& setDefaultFile(const char* filename);
     AsyncStaticWebHandler& setCacheControl(const char* cache_control);
@@ -71,17 +70,20 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
     ArRequestHandlerFunction _onRequest;
     ArUploadHandlerFunction _onUpload;
     ArBodyHandlerFunction _onBody;
-    bool _isRegex;
+    ArFormParamHandlerFunction _onFormParam;
+    AsyncWebRoute _route;
   public:
-    AsyncCallbackWebHandler() : _uri(), _method(HTTP_ANY), _onRequest(NULL), _onUpload(NULL), _onBody(NULL), _isRegex(false) {}
+    AsyncCallbackWebHandler() : _uri(), _method(HTTP_ANY), _onRequest(NULL), _onUpload(NULL), _onBody(NULL), _onFormParam(NULL) {}
     void setUri(String uri){ 
       _uri = std::move(uri); 
-      _isRegex = _uri.startsWith("^") && _uri.endsWith("$");
+      _route.set(_uri);
     }
     void setMethod(WebRequestMethodComposite method){ _method = method; }
     void onRequest(ArRequestHandlerFunction fn){ _onRequest = fn; }
     void onUpload(ArUploadHandlerFunction fn){ _onUpload = fn; }
     void onBody(ArBodyHandlerFunction fn){ _onBody = fn; }
+    // Receive urlencoded body fields as they are decoded, instead of as request params
+    void onFormParam(ArFormParamHandlerFunction fn){ _onFormParam = fn; }
 
     virtual bool canHandle(AsyncWebServerRequest *request) override final{
 
@@ -91,39 +93,9 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
       if(!(_method & request->method()))
         return false;
 
-#ifdef ASYNCWEBSERVER_REGEX
-      if (_isRegex) {
-        std::regex pattern(_uri.c_str());
-        std::smatch matches;
-        std::string s(request->url().c_str());
-        if(std::regex_search(s, matches, pattern)) {
-          for (size_t i = 1; i < matches.size(); ++i) { // start from 1
-            request->_addPathParam(matches[i].str().c_str());
-          }
-        } else {
-          return false;
-        }
-      } else 
-#endif
-      if (_uri.length() && _uri.startsWith("/*.")) {
-         String uriTemplate = String (_uri);
-         uriTemplate = uriTemplate.substring(uriTemplate.lastIndexOf("."));
-         if (!request->url().endsWith(uriTemplate))
-           return false;
-      }
-      else
-      if (_uri.length() && _uri.endsWith("*")) {
-        String uriTemplate = String(_uri);
-	uriTemplate = uriTemplate.substring(0, uriTemplate.length() - 1);
-        if (!request->url().startsWith(uriTemplate))
-          return false;
-      }
-      else if(_uri.length() && (_uri != request->url() && !request->url().startsWith(_uri+"/")))
-        return false;
-
-      request->addInterestingHeader("ANY");
-      return true;
+      return _route.match(request);
     }
+    virtual const AsyncWebRoute* route() const override { return &_route; }
   
     virtual void handleRequest(AsyncWebServerRequest *request) override final {
       if((_username != "" && _password != "") && !request->authenticate(_username.c_str(), _password.c_str()))
@@ -145,6 +117,14 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
       if(_onBody)
         _onBody(request, data, len, index, total);
     }
+    virtual bool handleFormParam(AsyncWebServerRequest *request, const char *name, const char *value, size_t len) override final {
+      if(!_onFormParam)
+        return false;
+      // Unauthenticated fields are dropped; handleRequest() asks for credentials
+      if((_username == "" || _password == "") || request->authenticate(_username.c_str(), _password.c_str()))
+        _onFormParam(request, name, value, len);
+      return true;
+    }
     virtual bool isRequestHandlerTrivial() override final {return _onRequest ? false : true;}
 };
 
@@ -21,6 +21,114 @@
 #include "ESPAsyncWebServer.h"
 #include "WebHandlerImpl.h"
 
+// Weight of each new measurement in the learned heap costs: 1 / 2^shift
+#ifndef ASYNCWEBSERVER_HEAP_COST_SHIFT
+#define ASYNCWEBSERVER_HEAP_COST_SHIFT 2
+#endif
+
+// Response size assumed for handlers with neither a hint nor any history
+#ifndef ASYNCWEBSERVER_EXPECTED_RESPONSE_SIZE
+#define ASYNCWEBSERVER_EXPECTED_RESPONSE_SIZE 4096
+#endif
+
+static_assert(HDR_KNOWN_COUNT <= 32, "AsyncWebHeaderFilter keeps one bit per well-known header");
+
+void AsyncWebHeaderFilter::add(WebRequestHeader id){
+  if(id < HDR_KNOWN_COUNT) _ids |= (1UL << id);
+}
+
+void AsyncWebHeaderFilter::add(const String& name){
+  if(name.equalsIgnoreCase(F("ANY"))){
+    _all = true;
+    return;
+  }
+  const WebRequestHeader id = AsyncWebServerRequest::headerId(name.c_str(), name.length());
+  if(id != HDR_UNKNOWN){
+    add(id);
+  } else if(!_names.containsIgnoreCase(name)){
+    _names.add(name);
+  }
+}
+
+void AsyncWebHeaderFilter::add(const AsyncWebHeaderFilter& other){
+  _all |= other._all;
+  _ids |= other._ids;
+  for(const auto& name: other._names){
+    if(!_names.containsIgnoreCase(name)) _names.add(name);
+  }
+}
+
+void AsyncWebHeaderFilter::clear(){
+  _ids = 0;
+  _names.free();
+  _all = false;
+}
+
+bool AsyncWebHeaderFilter::contains(WebRequestHeader id, const char* name, size_t len) const {
+  if(_all) return true;
+  if(id != HDR_UNKNOWN) return _ids & (1UL << id);
+  for(const auto& n: _names){
+    if((n.length() == len) && !strncasecmp(n.c_str(), name, len)) return true;
+  }
+  return false;
+}
+
+uint32_t AsyncWebHandler::_headerDeclarations = 0;
+
+AsyncWebHandler& AsyncWebHandler::addInterestingHeader(WebRequestHeader id){
+  _interestingHeaders.add(id);
+  _declaredHeaders = true;
+  ++_headerDeclarations;
+  return *this;
+}
+
+AsyncWebHandler& AsyncWebHandler::addInterestingHeader(const String& name){
+  _interestingHeaders.add(name);
+  _declaredHeaders = true;
+  ++_headerDeclarations;
+  return *this;
+}
+
+AsyncWebHandler& AsyncWebHandler::declareNoHeaders(){
+  _declaredHeaders = true;
+  ++_headerDeclarations;
+  return *this;
+}
+
+size_t AsyncWebHandler::requestHeapCost(AsyncWebServerRequest *request) const {
+  // The body is read before the handler starts, so measurements never include it
+  return std::max(_heapCost, _learnedHeapCost) + (_bodyInHeap ? request->contentLength() : 0);
+}
+
+// Exponentially weighted, so the estimate follows changes without one odd request moving it far
+static size_t running_average(size_t average, size_t sample){
+  if(!average) return sample;
+  return average + (((ptrdiff_t) sample - (ptrdiff_t) average) / (1 << ASYNCWEBSERVER_HEAP_COST_SHIFT));
+}
+
+void AsyncWebHandler::_recordHeapCost(size_t heap, size_t block){
+  _learnedHeapCost = running_average(_learnedHeapCost, heap);
+  _learnedBlockCost = running_average(_learnedBlockCost, block);
+}
+
+size_t AsyncWebHandler::expectedResponseSize(AsyncWebServerRequest *request __attribute__((unused))) const {
+  if(_expectedSize) return _expectedSize;
+  return _learnedResponseSize ? _learnedResponseSize : ASYNCWEBSERVER_EXPECTED_RESPONSE_SIZE;
+}
+
+void AsyncWebHandler::_recordResponseSize(size_t bytes){
+  _learnedResponseSize = running_average(_learnedResponseSize, bytes);
+}
+
+void AsyncWebHandler::collectInterestingHeaders(AsyncWebHeaderFilter& filter) const {
+  if(_declaredHeaders){
+    filter.add(_interestingHeaders);
+  } else {
+    // Never declared: this handler may look at anything
+    filter.addAll();
+  }
+}
+
 AsyncStaticWebHandler::AsyncStaticWebHandler(String uri, FS& fs, String path, const char* cache_control)
   : _fs(fs), _uri(std::move(uri)), _path(std::move(path)), _default_file("index.htm"), _cache_control(cache_control), _last_modified(""), _callback(nullptr)
 {
@@ -40,6 +148,15 @@ AsyncStaticWebHandler::AsyncStaticWebHandler(String uri, FS& fs, String path, co
   // Reset stats
   _gzipFirst = false;
   _gzipStats = 0xF8;
+
+  // Conditional requests, and partial content for resumed downloads and media seeking
+  addInterestingHeader(HDR_IF_MODIFIED_SINCE);
+  addInterestingHeader(HDR_IF_NONE_MATCH);
+  addInterestingHeader(HDR_RANGE);
+  addInterestingHeader(HDR_IF_RANGE);
+
+  // Only urls under _uri are worth a look; canHandle still decides
+  _route.set(_uri + "*");
 }
 
 AsyncStaticWebHandler& AsyncStaticWebHandler::setIsDir(bool isDir){
@@ -88,13 +205,6 @@ bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request){
     return false;
   }
   if (_getFile(request)) {
-    // We interested in "If-Modified-Since" header to check if file was modified
-    if (_last_modified.length())
-      request->addInterestingHeader("If-Modified-Since");
-
-    if(_cache_control.length())
-      request->addInterestingHeader("If-None-Match");
-
     DEBUGF("[AsyncStaticWebHandler::canHandle] TRUE\n");
     return true;
   }
@@ -134,6 +244,13 @@ bool AsyncStaticWebHandler::_getFile(AsyncWebServerRequest *request)
 #define FILE_IS_REAL(f) (f == true)
 #endif
 
+// The file canHandle() found; headers and conditional requests aside, that's the response
+size_t AsyncStaticWebHandler::expectedResponseSize(AsyncWebServerRequest *request) const
+{
+  if(request->_tempFile) return request->_tempFile.size();
+  return AsyncWebHandler::expectedResponseSize(request);
+}
+
 bool AsyncStaticWebHandler::_fileExists(AsyncWebServerRequest *request, const String& path)
 {
   bool fileFound = false;
@@ -195,10 +312,10 @@ void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest *request)
 
   if (request->_tempFile == true) {
     String etag = String(request->_tempFile.size());
-    if (_last_modified.length() && _last_modified == request->header("If-Modified-Since")) {
+    if (_last_modified.length() && _last_modified == request->header(HDR_IF_MODIFIED_SINCE)) {
       request->_tempFile.close();
       request->send(304); // Not modified
-    } else if (_cache_control.length() && request->hasHeader("If-None-Match") && request->header("If-None-Match").equals(etag)) {
+    } else if (_cache_control.length() && request->hasHeader(HDR_IF_NONE_MATCH) && etag.equals(request->headerValue(HDR_IF_NONE_MATCH))) {
       request->_tempFile.close();
       AsyncWebServerResponse * response = new AsyncBasicResponse(304); // Not modified
       response->addHeader("Cache-Control", _cache_control);
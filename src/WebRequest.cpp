@@ -30,7 +30,62 @@ static const String SharedEmptyString = String();
 
 #define __is_param_char(c) ((c) && ((c) != '{') && ((c) != '[') && ((c) != '&') && ((c) != '='))
 
-enum { PARSE_REQ_START, PARSE_REQ_HEADERS, PARSE_REQ_BODY, PARSE_REQ_END=100, PARSE_REQ_FAIL, PARSE_REQ_QUEUED=200, PARSE_REQ_DEFERRED=201 };
+enum { PARSE_REQ_START, PARSE_REQ_HEADERS, PARSE_REQ_BODY, PARSE_REQ_END=100, PARSE_REQ_FAIL, PARSE_REQ_QUEUED=200, PARSE_REQ_DEFERRED=201, PARSE_REQ_CONTINUE=202 };
+
+// Largest amount of pipelined request data held while a response is in progress
+#ifndef ASYNCWEBSERVER_PIPELINE_MAX
+#define ASYNCWEBSERVER_PIPELINE_MAX 2048
+#endif
+
+// Request line and headers are held in one buffer that starts at HEAD_CHUNK and doubles up to HEAD_MAX.
+// Header slots store 16 bit offsets, so HEAD_MAX must not exceed 64k.
+#ifndef ASYNCWEBSERVER_HEAD_CHUNK
+#define ASYNCWEBSERVER_HEAD_CHUNK 256
+#endif
+#ifndef ASYNCWEBSERVER_HEAD_MAX
+#define ASYNCWEBSERVER_HEAD_MAX 8192
+#endif
+#if ASYNCWEBSERVER_HEAD_MAX > 65535
+#error ASYNCWEBSERVER_HEAD_MAX must fit in 16 bits
+#endif
+
+// Longest multipart boundary accepted; RFC 2046 allows 70
+#ifndef ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX
+#define ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX 70
+#endif
+#if ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX > 250
+#error ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX must leave the delimiter length in 8 bits
+#endif
+
+// Names of the well-known headers, indexed by WebRequestHeader
+static const char KNOWN_HEADER_NAMES[][25] PROGMEM = {
+  "Host",
+  "Connection",
+  "Content-Type",
+  "Content-Length",
+  "Transfer-Encoding",
+  "Expect",
+  "Authorization",
+  "Accept",
+  "Accept-Encoding",
+  "If-None-Match",
+  "If-Modified-Since",
+  "Range",
+  "If-Range",
+  "Upgrade",
+  "Origin",
+  "Sec-WebSocket-Key",
+  "Sec-WebSocket-Version",
+  "Sec-WebSocket-Protocol",
+  "Sec-WebSocket-Extensions",
+  "Cookie",
+  "Last-Event-ID",
+};
+static_assert(sizeof(KNOWN_HEADER_NAMES) / sizeof(KNOWN_HEADER_NAMES[0]) == HDR_KNOWN_COUNT, "KNOWN_HEADER_NAMES must match WebRequestHeader");
+
+// Headers the parser acts on itself; these are always read in full
+static const uint32_t PARSER_HEADERS = (1UL << HDR_HOST) | (1UL << HDR_CONNECTION) | (1UL << HDR_CONTENT_TYPE)
+  | (1UL << HDR_CONTENT_LENGTH) | (1UL << HDR_TRANSFER_ENCODING) | (1UL << HDR_EXPECT) | (1UL << HDR_AUTHORIZATION) | (1UL << HDR_ACCEPT) | (1UL << HDR_UPGRADE);
 
 #ifdef ASYNCWEBSERVER_DEBUG_TRACE
 #define DEBUG_PRINTFP(fmt, ...) Serial.printf_P(PSTR("[%u]{%d}" fmt "\n"), (unsigned) millis(), ESP.getFreeHeap(), ##__VA_ARGS__)
@@ -56,6 +111,62 @@ static bool concat(String& s, char* p, unsigned l) {
 static inline bool concat(String& s, char* p, unsigned l) { return s.concat(p, l); };
 #endif
 
+/*
+ * MULTIPART SCAN :: Finds "\r\n--boundary" in body data with a Horspool search
+ *
+ * Only the bytes at the end of a packet that could be the start of a delimiter are held
+ * back; everything else is handed on where it lies.
+ * */
+
+struct AsyncWebMultipartScan {
+  uint8_t skip[256];      // distance to shift the search window, by its last byte
+  uint8_t length;         // of the delimiter
+  uint8_t carried;        // bytes of a possible delimiter held over from the previous packet
+  uint8_t delimiter[ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX + 4];
+  uint8_t carry[ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX + 4];
+
+  void setup(const String& boundary){
+    length = boundary.length() + 4;
+    memcpy(delimiter, "\r\n--", 4);
+    memcpy(delimiter + 4, boundary.c_str(), boundary.length());
+    memset(skip, length, sizeof(skip));
+    for(size_t i = 0; i < (size_t) length - 1; ++i) skip[delimiter[i]] = length - 1 - i;
+    // The body starts with a delimiter but no line break; act as if there had been one
+    memcpy(carry, delimiter, 2);
+    carried = 2;
+  }
+
+  // Offset of the first complete delimiter in data, or len
+  size_t find(const uint8_t* data, size_t len) const {
+    const uint8_t last = delimiter[length - 1];
+    size_t i = 0;
+    while(i + length <= len){
+      const uint8_t c = data[i + length - 1];
+      if((c == last) && !memcmp(data + i, delimiter, length - 1)) return i;
+      i += skip[c];
+    }
+    return len;
+  }
+
+  // Offset of the tail of data that could be the start of a delimiter, or len
+  size_t partial(const uint8_t* data, size_t len) const {
+    size_t i = (len >= length) ? (len - length + 1) : 0;
+    while(i < len){
+      const uint8_t* cr = (const uint8_t*) memchr(data + i, '\r', len - i);
+      if(!cr) break;
+      i = cr - data;
+      if(!memcmp(cr, delimiter, len - i)) return i;
+      ++i;
+    }
+    return len;
+  }
+
+  void hold(const uint8_t* data, size_t len){
+    memcpy(carry, data, len);
+    carried = len;
+  }
+};
+
 AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* server, AsyncClient* client)
   : _client(client)
   , _server(server)
@@ -63,6 +174,17 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* server, AsyncClient
   , _response(NULL)
   , _temp()
   , _parseState(0)
+  , _queuePrev(NULL)
+  , _queueNext(NULL)
+  , _queueList(NULL)
+  , _remoteAddress(client->getRemoteAddress())
+  , _queuedAt(0)
+  , _expectedSize(0)
+  , _fairSkips(0)
+  , _offloadJob()
+  , _offloaded(false)
+  , _orphaned(false)
+  , _pipelined()
   , _version(0)
   , _method(HTTP_ANY)
   , _url()
@@ -75,20 +197,41 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* server, AsyncClient
   , _isMultipart(false)
   , _isPlainPost(false)
   , _expectingContinue(false)
+  , _keepAlive(false)
+  , _headerChecked(false)
+  , _skipHeader(false)
+  , _chunked(false)
+  , _chunkState(0)
+  , _chunkLeft(0)
   , _contentLength(0)
   , _parsedLength(0)
-  , _headers({})
+  , _requestCount(0)
+  , _heapStart(0)
+  , _heapLow(0)
+  , _blockStart(0)
+  , _blockLow(0)
+  , _head()
+  , _headLength(0)
+  , _lineStart(0)
+  , _lineLength(0)
+  , _headerBytes(0)
+  , _headerCount(0)
+  , _knownHeaders()
+  , _headerSlots()
   , _params({})
+  , _paramIndex()
+  , _queryStart(0)
+  , _queryLength(0)
   , _pathParams({})
   , _multiParseState(0)
-  , _boundaryPosition(0)
+  , _multipart(NULL)
   , _itemStartIndex(0)
   , _itemSize(0)
   , _itemName()
   , _itemFilename()
   , _itemType()
   , _itemValue()
-  , _itemBuffer(0)
+  , _itemBuffer()
   , _itemBufferIndex(0)
   , _itemIsFile(false)
   , _tempObject(NULL)
@@ -96,7 +239,7 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* server, AsyncClient
   DEBUG_PRINTFP("(%x) WR created", (intptr_t)this);
   _client->onError([](void *r, AsyncClient* c, int8_t error){ (void)c; AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; req->_onError(error); }, this);
   _client->onAck([](void *r, AsyncClient* c, size_t len, uint32_t time){ (void)c; AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; req->_onAck(len, time); }, this);
-  _client->onDisconnect([](void *r, AsyncClient* c){ AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; req->_onDisconnect(); delete c; }, this);
+  _client->onDisconnect([](void *r, AsyncClient* c){ AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; if(req->_onDisconnect()) delete c; }, this);
   _client->onTimeout([](void *r, AsyncClient* c, uint32_t time){ (void)c; AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; req->_onTimeout(time); }, this);
   _client->onData([](void *r, AsyncClient* c, void *buf, size_t len){ (void)c; AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; req->_onData(buf, len); }, this);
   _client->onPoll([](void *r, AsyncClient* c){ (void)c; AsyncWebServerRequest *req = ( AsyncWebServerRequest*)r; req->_onPoll(); }, this);
@@ -104,14 +247,13 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* server, AsyncClient
 
 AsyncWebServerRequest::~AsyncWebServerRequest(){
   DEBUG_PRINTFP("(%x) WR destructing", (intptr_t)this);
+  _endSample();
 
-  _headers.free();
+  _clearHeaders();
 
-  _params.free();
+  _clearParams();
   _pathParams.free();
 
-  _interestingHeaders.free();
-
   if(_response != NULL){
     delete _response;
   }
@@ -124,6 +266,11 @@ AsyncWebServerRequest::~AsyncWebServerRequest(){
     _tempFile.close();
   }
 
+  if(_multipart){
+    free(_multipart);
+  }
+  _server->_returnUploadBuffer(std::move(_itemBuffer));
+
   _server->_dequeue(this);
   
   DEBUG_PRINTFP("(%x) WR destructed", (intptr_t)this);
@@ -134,104 +281,225 @@ void AsyncWebServerRequest::_onData(void *buf, size_t len){
   while (true) {
 
   if(_parseState < PARSE_REQ_BODY){
-    // Find new line in buf
+    // Copy up to the end of line in to the head buffer; complete lines are parsed in place
     char* str = (char*) buf;
     char* nl = (char*) memchr(buf, '\n', len);
-    if (nl != nullptr) { // Found new line - extract it and parse
-      size_t line_len = nl - str;
-      concat(_temp, str, line_len);
-      _temp.trim();
-      _parseLine();
-      if (++line_len+1 < len) {
+    size_t line_len = nl ? (size_t) (nl - str) : len;
+    size_t copy_len = line_len;
+    if((_parseState == PARSE_REQ_HEADERS) && !_lineLength && line_len && (str[0] != '\r')) ++_headerCount;
+    _lineLength += line_len;
+    const int limitStatus = _headLimitStatus();
+    if(limitStatus){
+      _rejectHead(limitStatus);
+      break;
+    }
+    if((_parseState == PARSE_REQ_HEADERS) && !_headerChecked){
+      // Stop at the end of the header name, so unwanted headers are never held in full
+      const char* colon = (const char*) memchr(str, ':', line_len);
+      if(colon) copy_len = colon - str;
+    }
+    bool ok = _skipHeader || _appendHead(str, copy_len);
+    if(ok && (copy_len < line_len)){
+      _headerChecked = true;
+      if(!_keepHeaderLine()){
+        _headLength = _lineStart;
+        _skipHeader = true;
+      } else {
+        ok = _appendHead(str + copy_len, line_len - copy_len);
+      }
+    }
+    if(!ok){
+      // Out of head buffer, or out of memory
+      _rejectHead((_parseState == PARSE_REQ_START) ? 414 : 431);
+      break;
+    }
+    if (nl != nullptr) {
+      if(_parseState == PARSE_REQ_HEADERS) _headerBytes += _lineLength + 1;
+      _lineLength = 0;
+      if(!_skipHeader) _parseLine();
+      _headerChecked = _skipHeader = false;
+      if (++line_len < len) {
         // Still have more buffer to process
         buf = (void*) (str + line_len);
         len -= line_len;
         continue;
       }
-    } else {
-      // No new line, just add the buffer in _temp
-      concat(_temp, str, len);
     }
   } else if(_parseState == PARSE_REQ_BODY){
-    // A handler should be already attached at this point in _parseLine function.
-    // If handler does nothing (_onRequest is NULL), we don't need to really parse the body.
-    const bool needParse = _handler && !_handler->isRequestHandlerTrivial();
-      // Discard any bytes after content length; handlers may overrun their buffers
-      len = std::min(len, _contentLength - _parsedLength);
-    if(_isMultipart){
-      if(needParse){
-        size_t i;
-        for(i=0; i<len; i++){
-          _parseMultipartPostByte(((uint8_t*)buf)[i], i == len - 1);
-          _parsedLength++;
-        }
-      } else
-          _parsedLength += len;
+    // Bytes after the body belong to the next request; handlers may overrun their buffers
+    const size_t fullLen = len;
+    if(_chunked){
+      len = _parseChunked((uint8_t*)buf, len);
     } else {
-      if(_parsedLength == 0){
-        if(_contentType.startsWith(F("application/x-www-form-urlencoded"))){
-          _isPlainPost = true;
-        } else if(_contentType == FPSTR(CONTENT_TYPE_PLAIN) && __is_param_char(((char*)buf)[0])){
-          size_t i = 0;
-          while (i<len && __is_param_char(((char*)buf)[i++]));
-          if(i < len && ((char*)buf)[i-1] == '='){
-            _isPlainPost = true;
-          }
-        }
-      }
-      if(!_isPlainPost) {
-        //check if authenticated before calling the body
-        if(_handler) _handler->handleBody(this, (uint8_t*)buf, len, _parsedLength, _contentLength);
-        _parsedLength += len;
-      } else if(needParse) {
-        size_t i;
-        for(i=0; i<len; i++){
-          _parsedLength++;
-          _parsePlainPostChar(((uint8_t*)buf)[i]);
-        }
-      } else {
-        _parsedLength += len;
+      len = std::min(len, _contentLength - _parsedLength);
+      _parseBody((uint8_t*)buf, len, _parsedLength + len == _contentLength);
+      if(_parsedLength == _contentLength){
+        _requestReady();
       }
     }
-    if(_parsedLength == _contentLength){
-      _requestReady();
+    if(fullLen > len){
+      buf = (void*) (((uint8_t*) buf) + len);
+      len = fullLen - len;
+      continue;
     }
+  } else if(_parseState == PARSE_REQ_CONTINUE){
+    // The client stopped waiting for 100 Continue and sent the body anyway
+    _expectingContinue = false;
+    _setParseState(PARSE_REQ_BODY);
+    continue;
+  } else if(_keepAlive){
+    // The response to this request is still in progress; hold on to the next one
+    _bufferPipelined(buf, len);
   }
   break;
   }
 }
 
-void AsyncWebServerRequest::_removeNotInterestingHeaders(){
-  if (_interestingHeaders.containsIgnoreCase("ANY")) return; // nothing to do
-  auto prev = decltype(_headers.begin()) { nullptr };
-  for(auto it = _headers.begin(); it != _headers.end(); prev = it, ++it){
-      if(!_interestingHeaders.containsIgnoreCase(it->name().c_str())){
-        _headers.remove(it, prev);
-        it = prev;
-      }
+void AsyncWebServerRequest::_bufferPipelined(const void *buf, size_t len){
+  const size_t used = _pipelined.size();
+  if((used + len > ASYNCWEBSERVER_PIPELINE_MAX) || (_pipelined.resize(used + len) != (used + len))){
+    // Can't hold it all: finish the current response, then close.  The client will retry what we dropped.
+    DEBUG_PRINTFP("(%x) WR pipeline overflow %u+%u", (intptr_t) this, used, len);
+    _keepAlive = false;
+    _pipelined.clear();
+    return;
+  }
+  memcpy(_pipelined.data() + used, buf, len);
+}
+
+// 0 if the head received so far is within the server's limits, otherwise the status to refuse it with
+int AsyncWebServerRequest::_headLimitStatus() const {
+  const AsyncWebServerHeadLimits& limits = _server->getHeadLimits();
+  if(_parseState == PARSE_REQ_START){
+    return (limits.requestLineMax && (_lineLength > limits.requestLineMax)) ? 414 : 0;
+  }
+  if((limits.headerLineMax && (_lineLength > limits.headerLineMax))
+      || (limits.headerBytesMax && (_headerBytes + _lineLength > limits.headerBytesMax))
+      || (limits.headerCountMax && (_headerCount > limits.headerCountMax))){
+    return 431;
+  }
+  return 0;
+}
+
+void AsyncWebServerRequest::_rejectHead(int code, uint32_t retryAfter){
+  // Prebuilt, so refusing a request takes no more memory than the request already has
+  const static char response503retry[] PROGMEM = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nRetry-After: %u\r\nContent-Length: 0\r\n\r\n";
+  const static char response400[] PROGMEM = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  const static char response413[] PROGMEM = "HTTP/1.1 413 Payload Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  const static char response414[] PROGMEM = "HTTP/1.1 414 URI Too Long\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  const static char response417[] PROGMEM = "HTTP/1.1 417 Expectation Failed\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  const static char response431[] PROGMEM = "HTTP/1.1 431 Request Header Fields Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  const static char response503[] PROGMEM = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  PGM_P response;
+  switch(code){
+    case 400: response = response400; break;
+    case 413: response = response413; break;
+    case 414: response = response414; break;
+    case 417: response = response417; break;
+    case 503: response = response503; break;
+    default:  response = response431; break;
+  }
+  char response_stack[sizeof(response503retry) + 8];  // stack, so we can pull it out of flash memory; 503 with a retry time is the longest
+  if((code == 503) && retryAfter){
+    snprintf_P(response_stack, sizeof(response_stack), response503retry, (unsigned) retryAfter);
+  } else {
+    strcpy_P(response_stack, response);
   }
+  DEBUG_PRINTFP("(%x) WR refused %d", (intptr_t) this, code);
+  _client->write(response_stack, os_strlen(response_stack));
+  // Nothing more is read; the connection is closed once the refusal is acked (or times out),
+  // since closing with anything unacked or unread would reset it away
+  _setParseState(PARSE_REQ_FAIL);
+  _keepAlive = false;
+}
+
+bool AsyncWebServerRequest::_appendHead(const char* data, size_t len){
+  // Always keep room for the NUL that terminates the line in place
+  const size_t needed = _headLength + len + 1;
+  if(needed > _head.size()){
+    if(needed > ASYNCWEBSERVER_HEAD_MAX) return false;
+    size_t size = _head.size() ? _head.size() : ASYNCWEBSERVER_HEAD_CHUNK;
+    while(size < needed) size *= 2;
+    size = std::min(size, (size_t) ASYNCWEBSERVER_HEAD_MAX);
+    if(_head.resize(size) != size) return false;
+  }
+  memcpy(_head.data() + _headLength, data, len);
+  _headLength += len;
+  return true;
+}
+
+void AsyncWebServerRequest::_clearHeaders(){
+  for(auto& slot: _knownHeaders){
+    delete slot.header;
+    slot = AsyncWebHeaderSlot {0, 0, nullptr};
+  }
+  for(const auto& slot: _headerSlots){
+    delete slot.header;
+  }
+  _headerSlots.clear();
+  _headLength = 0;
+  _lineStart = 0;
+}
+
+bool AsyncWebServerRequest::_keepHeaderLine() const {
+  // The name of the current header line is complete in the head buffer
+  const char* head = _head.data();
+  size_t start = _lineStart, end = _headLength;
+  while((end > start) && isspace((unsigned char) head[end-1])) --end;
+  while((start < end) && isspace((unsigned char) head[start])) ++start;
+  const WebRequestHeader id = headerId(head + start, end - start);
+  if((id != HDR_UNKNOWN) && (PARSER_HEADERS & (1UL << id))) return true;
+  return _server->_getInterestingHeaders().contains(id, head + start, end - start);
 }
 
 void AsyncWebServerRequest::_onPoll(){
   //os_printf("p\n");
-  if (_parseState == PARSE_REQ_QUEUED) {
-    _server->processQueue();
+  AsyncWebServer* server = _server;   // acking may delete us
+  if (_offloaded) {
+    // The worker may be setting up the response
+  } else if (_parseState == PARSE_REQ_QUEUED) {
+    server->processQueue();
   } else if(_response != NULL && _client != NULL && _client->canSend() && !_response->_finished()){
-    _response->_ack(this, 0, 0);
+    _ackResponse(0, 0);
+  }
+  // Run any pass asked for from another task
+  server->_serviceQueue();
+}
+
+void AsyncWebServerRequest::_ackResponse(size_t len, uint32_t time){
+  // Responses that hand the client over (websocket, event source) may delete us from _ack;
+  // those never permit keep-alive, so only touch members afterwards if it was set.
+  const bool keepAlive = _keepAlive;
+  _sampleHeap();
+  _response->_ack(this, len, time);
+  if (keepAlive && _response->_finished() && !_response->_failed()) {
+    if (_keepAlive) {
+      _recycle();
+    } else {
+      // Persistence was revoked after the response headers went out
+      _client->close();
+    }
   }
 }
 
 void AsyncWebServerRequest::_onAck(size_t len, uint32_t time){
   //os_printf("a:%u:%u\n", len, time);
-  if(_response != NULL){
+  AsyncWebServer* server = _server;   // acking may delete us
+  if(_response != NULL && !_offloaded){
     if(!_response->_finished()){
-      _response->_ack(this, len, time);
+      _ackResponse(len, time);
     } else {
+      _endSample();
       AsyncWebServerResponse* r = _response;
       _response = NULL;
       delete r;
+      server->notifyResourcesFreed();
     }
+  } else if(len && (_parseState == PARSE_REQ_FAIL)){
+    // The refusal has been acked
+    _client->close();
   }
+  server->_serviceQueue();
 }
 
 void AsyncWebServerRequest::_onError(int8_t error){
@@ -248,73 +516,168 @@ void AsyncWebServerRequest::onDisconnect (ArDisconnectHandler fn){
     _onDisconnectfn=fn;
 }
 
-void AsyncWebServerRequest::_onDisconnect(){
+bool AsyncWebServerRequest::_onDisconnect(){
   //os_printf("d\n");
   if(_onDisconnectfn) {
       _onDisconnectfn();
     }
-  _server->_handleDisconnect(this);
+  return _server->_handleDisconnect(this);
+}
+
+// FNV-1a; parameter names are compared by hash before their text
+static uint32_t param_hash(const char* name, size_t len){
+  uint32_t hash = 2166136261UL;
+  while(len--) hash = (hash ^ (uint8_t) *name++) * 16777619UL;
+  return hash;
+}
+
+static uint32_t param_hash_P(PGM_P name, size_t len){
+  uint32_t hash = 2166136261UL;
+  while(len--) hash = (hash ^ (uint8_t) pgm_read_byte(name++)) * 16777619UL;
+  return hash;
 }
 
 void AsyncWebServerRequest::_addParam(AsyncWebParameter p){
+  // Keep arrival order: anything in the query string came first
+  _parseQuery();
+  const uint32_t hash = param_hash(p.name().c_str(), p.name().length());
   _params.add(std::move(p));
+  _paramIndex.push_back(ParamRef { hash, &_params.back() });
+}
+
+void AsyncWebServerRequest::_parseQuery() const {
+  if(!_queryLength) return;
+  const size_t len = _queryLength;
+  _queryLength = 0;
+  const_cast<AsyncWebServerRequest*>(this)->_addGetParams(_head.data() + _queryStart, len);
+}
+
+void AsyncWebServerRequest::_clearParams(){
+  _params.free();
+  _paramIndex.clear();
+  _queryStart = _queryLength = 0;
+}
+
+const AsyncWebParameter* AsyncWebServerRequest::_findParam(const char* name, size_t len, bool any, bool post, bool file) const {
+  _parseQuery();
+  const uint32_t hash = param_hash(name, len);
+  for(const auto& ref: _paramIndex){
+    const AsyncWebParameter* p = ref.param;
+    if((ref.hash == hash) && (p->name().length() == len) && !memcmp(p->name().c_str(), name, len)
+        && (any || ((p->isPost() == post) && (p->isFile() == file)))){
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+const AsyncWebParameter* AsyncWebServerRequest::_findParam_P(PGM_P name, bool any, bool post, bool file) const {
+  _parseQuery();
+  const size_t len = strlen_P(name);
+  const uint32_t hash = param_hash_P(name, len);
+  for(const auto& ref: _paramIndex){
+    const AsyncWebParameter* p = ref.param;
+    if((ref.hash == hash) && (p->name().length() == len) && !strcmp_P(p->name().c_str(), name)
+        && (any || ((p->isPost() == post) && (p->isFile() == file)))){
+      return p;
+    }
+  }
+  return nullptr;
 }
 
 void AsyncWebServerRequest::_addPathParam(const char *p){
   _pathParams.add(String(p));
 }
 
+void AsyncWebServerRequest::_addPathParam(const char *p, size_t len){
+  String param;
+  concat(param, const_cast<char*>(p), len);
+  _pathParams.add(std::move(param));
+}
+
 void AsyncWebServerRequest::_addGetParams(const String& params){
-  size_t start = 0;
-  while (start < params.length()){
-    int end = params.indexOf('&', start);
-    if (end < 0) end = params.length();
-    int equal = params.indexOf('=', start);
-    if (equal < 0 || equal > end) equal = end;
-    String name = params.substring(start, equal);
-    String value = equal + 1 < end ? params.substring(equal + 1, end) : String();
-    _addParam(AsyncWebParameter(urlDecode(name), urlDecode(value)));
-    start = end + 1;
-  }
-}
-
-bool AsyncWebServerRequest::_parseReqHead(){
-  // Split the head into method, url and version
-  int index = _temp.indexOf(' ');
-  String m = _temp.substring(0, index);
-  index = _temp.indexOf(' ', index+1);
-  String u = _temp.substring(m.length()+1, index);
-  _temp = _temp.substring(index+1);
-
-  if(m == F("GET")){
-    _method = HTTP_GET;
-  } else if(m == F("POST")){
-    _method = HTTP_POST;
-  } else if(m == F("DELETE")){
-    _method = HTTP_DELETE;
-  } else if(m == F("PUT")){
-    _method = HTTP_PUT;
-  } else if(m == F("PATCH")){
-    _method = HTTP_PATCH;
-  } else if(m == F("HEAD")){
-    _method = HTTP_HEAD;
-  } else if(m == F("OPTIONS")){
-    _method = HTTP_OPTIONS;
-  }
-
-  String g = String();
-  index = u.indexOf('?');
-  if(index > 0){
-    g = u.substring(index +1);
-    u = u.substring(0, index);
-  }
-  _url = urlDecode(u);
-  _addGetParams(g);
-
-  if(!_temp.startsWith(F("HTTP/1.0")))
+  _addGetParams(params.c_str(), params.length());
+}
+
+void AsyncWebServerRequest::_addGetParams(const char* params, size_t len){
+  const char* end = params + len;
+  while (params < end){
+    const char* amp = (const char*) memchr(params, '&', end - params);
+    if (!amp) amp = end;
+    const char* equal = (const char*) memchr(params, '=', amp - params);
+    if (!equal) equal = amp;
+    const char* value = (equal < amp) ? (equal + 1) : amp;
+    _addParam(AsyncWebParameter(_urlDecode(params, equal - params), _urlDecode(value, amp - value)));
+    params = amp + 1;
+  }
+}
+
+// Case insensitive search for a flash string token in a header value
+static bool value_contains_P(const char* value, PGM_P token){
+  const size_t len = strlen_P(token);
+  for(; *value; ++value){
+    if(!strncasecmp_P(value, token, len)) return true;
+  }
+  return false;
+}
+
+// Packs a method token's length and first four bytes, so it can be switched on; usable on literals
+// at compile time.  Longer tokens sharing a prefix collide, so a match must be confirmed on the
+// whole token.
+static constexpr uint32_t method_key(const char* s, size_t len){
+  return ((len < 3) || (len > 7)) ? 0 :
+    (((uint32_t) len << 28) | ((uint32_t) (s[0] & 0x7F) << 21) | ((uint32_t) (s[1] & 0x7F) << 14)
+      | ((uint32_t) (s[2] & 0x7F) << 7) | (uint32_t) ((len > 3) ? (s[3] & 0x7F) : 0));
+}
+
+// Known method for the token, or 0 for an extension method
+static WebRequestMethodComposite method_from_token(const char* token, size_t len){
+  WebRequestMethodComposite method;
+  PGM_P name;
+  switch(method_key(token, len)){
+    case method_key("GET", 3):     method = HTTP_GET;     name = PSTR("GET");     break;
+    case method_key("POST", 4):    method = HTTP_POST;    name = PSTR("POST");    break;
+    case method_key("DELETE", 6):  method = HTTP_DELETE;  name = PSTR("DELETE");  break;
+    case method_key("PUT", 3):     method = HTTP_PUT;     name = PSTR("PUT");     break;
+    case method_key("PATCH", 5):   method = HTTP_PATCH;   name = PSTR("PATCH");   break;
+    case method_key("HEAD", 4):    method = HTTP_HEAD;    name = PSTR("HEAD");    break;
+    case method_key("OPTIONS", 7): method = HTTP_OPTIONS; name = PSTR("OPTIONS"); break;
+    default: return 0;
+  }
+  // The key only covers the first four (7 bit) characters
+  return memcmp_P(token, name, len) ? 0 : method;
+}
+
+bool AsyncWebServerRequest::_parseReqHead(char* line, size_t len){
+  // Split the head into method, url and version where it lies
+  char* end = line + len;
+  char* uri = (char*) memchr(line, ' ', len);
+  if(!uri) uri = end;
+  const size_t methodLen = uri - line;
+  if(uri < end) ++uri;
+  char* version = (char*) memchr(uri, ' ', end - uri);
+  if(!version) version = end;
+
+  // Unknown methods are left at 0, which no handler accepts
+  _method = method_from_token(line, methodLen);
+
+  const char* query = (const char*) memchr(uri, '?', version - uri);
+  if(query > uri){
+    _url = _urlDecode(uri, query - uri);
+    // Left as it is until a parameter is asked for
+    _queryStart = query + 1 - _head.data();
+    _queryLength = version - query - 1;
+  } else {
+    _url = _urlDecode(uri, version - uri);
+  }
+
+  if(version < end) ++version;
+  if(strncmp_P(version, PSTR("HTTP/1.0"), 8))
     _version = 1;
 
-  _temp = String();
+  // HTTP/1.1 connections are persistent unless the client says otherwise
+  _keepAlive = (_version == 1);
+
   return true;
 }
 
@@ -336,293 +699,535 @@ bool strContains(String src, String find, bool mindcase = true) {
   return false;
 }
 
-bool AsyncWebServerRequest::_parseReqHeader(){
-  int index = _temp.indexOf(':');
-  if(index){
-    String name = _temp.substring(0, index);
-    String value = _temp.substring(index + 2);
-    if(name.equalsIgnoreCase(F("Host"))){
-      _host = value;
-    } else if(name.equalsIgnoreCase(F("Content-Type"))){
-	  _contentType = value.substring(0, value.indexOf(';'));
-      if (value.startsWith(F("multipart/"))){
-        _boundary = value.substring(value.indexOf('=')+1);
-        _boundary.replace("\"","");
-        _isMultipart = true;
-      }
-    } else if(name.equalsIgnoreCase(F("Content-Length"))){
-      _contentLength = atoi(value.c_str());
-    } else if(name.equalsIgnoreCase(F("Expect")) && value == F("100-continue")){
-      _expectingContinue = true;
-    } else if(name.equalsIgnoreCase(F("Authorization"))){
-      if(value.length() > 5 && value.substring(0,5).equalsIgnoreCase(F("Basic"))){
-        _authorization = value.substring(6);
-      } else if(value.length() > 6 && value.substring(0,6).equalsIgnoreCase(F("Digest"))){
-        _isDigest = true;
-        _authorization = value.substring(7);
+bool AsyncWebServerRequest::_parseReqHeader(char* line, size_t len){
+  char* colon = (char*) memchr(line, ':', len);
+  if(colon > line){
+    // Terminate the name over the colon; both name and value stay in the head buffer
+    *colon = 0;
+    const char* name = line;
+    char* value = colon + 1;
+    while(*value == ' ' || *value == '\t') ++value;
+    const size_t valueLen = (line + len) - value;
+
+    const WebRequestHeader id = headerId(name, colon - line);
+    switch(id){
+      case HDR_HOST:
+        _host = value;
+        break;
+      case HDR_CONTENT_TYPE: {
+        const char* semicolon = (const char*) memchr(value, ';', valueLen);
+        _contentType = String();
+        concat(_contentType, value, semicolon ? (semicolon - value) : valueLen);
+        if (!strncmp_P(value, PSTR("multipart/"), 10)){
+          const char* equal = strchr(value, '=');
+          _boundary = equal ? (equal + 1) : value;
+          _boundary.replace("\"","");
+          _isMultipart = true;
+        }
+        break;
       }
-    } else {
-      if(name.equalsIgnoreCase(F("Upgrade")) && value.equalsIgnoreCase(F("websocket"))){
+      case HDR_CONTENT_LENGTH:
+        _contentLength = atoi(value);
+        break;
+      case HDR_TRANSFER_ENCODING:
+        if(value_contains_P(value, PSTR("chunked"))) _chunked = true;
+        break;
+      case HDR_EXPECT:
+        if(!strcmp_P(value, PSTR("100-continue"))) _expectingContinue = true;
+        break;
+      case HDR_CONNECTION:
+        if(value_contains_P(value, PSTR("close"))){
+          _keepAlive = false;
+        } else if(value_contains_P(value, PSTR("keep-alive"))){
+          _keepAlive = true;
+        }
+        break;
+      case HDR_AUTHORIZATION:
+        if(valueLen > 5 && !strncasecmp_P(value, PSTR("Basic"), 5)){
+          _authorization = value + 6;
+        } else if(valueLen > 6 && !strncasecmp_P(value, PSTR("Digest"), 6)){
+          _isDigest = true;
+          _authorization = value + 7;
+        }
+        break;
+      case HDR_UPGRADE:
         // WebSocket request can be uniquely identified by header: [Upgrade: websocket]
-        _reqconntype = RCT_WS;
-      } else {
-        if(name.equalsIgnoreCase(F("Accept")) && strContains(value, F("text/event-stream"), false)){
-          // WebEvent request can be uniquely identified by header:  [Accept: text/event-stream]
-          _reqconntype = RCT_EVENT;
+        if(!strcasecmp_P(value, PSTR("websocket"))) _reqconntype = RCT_WS;
+        break;
+      case HDR_ACCEPT:
+        // WebEvent request can be uniquely identified by header:  [Accept: text/event-stream]
+        if(value_contains_P(value, PSTR("text/event-stream"))) _reqconntype = RCT_EVENT;
+        break;
+      default:
+        break;
+    }
+    if(!_server->_getInterestingHeaders().contains(id, name, colon - line)){
+      return false;
+    }
+
+    const AsyncWebHeaderSlot slot { (uint16_t) (name - _head.data()), (uint16_t) (value - _head.data()), nullptr };
+    if((id != HDR_UNKNOWN) && !_knownHeaders[id].name){
+      _knownHeaders[id] = slot;
+    } else {
+      _headerSlots.push_back(slot);
+    }
+    return true;
+  }
+  return false;
+}
+
+void AsyncWebServerRequest::_parseBody(uint8_t* data, size_t len, bool last){
+  // A handler should be already attached at this point in _parseLine function.
+  // If handler does nothing (_onRequest is NULL), we don't need to really parse the body.
+  const bool needParse = _handler && !_handler->isRequestHandlerTrivial();
+  if(_isMultipart){
+    if(needParse && len) _parseMultipart(data, len);
+  } else {
+    if(_parsedLength == 0 && len){
+      if(_contentType.startsWith(F("application/x-www-form-urlencoded"))){
+        _isPlainPost = true;
+      } else if(_contentType == FPSTR(CONTENT_TYPE_PLAIN) && __is_param_char(((char*)data)[0])){
+        size_t i = 0;
+        while (i<len && __is_param_char(((char*)data)[i++]));
+        if(i < len && ((char*)data)[i-1] == '='){
+          _isPlainPost = true;
         }
       }
     }
-    _headers.add(AsyncWebHeader(name, value));
+    if(!_isPlainPost) {
+      //check if authenticated before calling the body
+      if(_handler && len) _handler->handleBody(this, data, len, _parsedLength, _contentLength);
+    } else if(needParse) {
+      _parsePlainPost((char*)data, len, last);
+    }
   }
-  _temp = String();
-  return true;
+  _parsedLength += len;
 }
 
-void AsyncWebServerRequest::_parsePlainPostChar(uint8_t data){
-  if(data && (char)data != '&')
-    _temp += (char)data;
-  if(!data || (char)data == '&' || _parsedLength == _contentLength){
-    String name = F("body");
-    String value = _temp;
-    if(!_temp.startsWith("{") && !_temp.startsWith("[") && _temp.indexOf('=') > 0){
-      name = _temp.substring(0, _temp.indexOf('='));
-      value = _temp.substring(_temp.indexOf('=') + 1);
+enum {
+  CHUNK_START,        // first digit of the size line
+  CHUNK_SIZE,
+  CHUNK_EXTENSION,    // rest of the size line
+  CHUNK_DATA,
+  CHUNK_DATA_END,     // line break after the data
+  CHUNK_TRAILER,      // start of a trailer line, or the blank line that ends the body
+  CHUNK_TRAILER_LINE
+};
+
+// De-frames a chunked body, passing the data on as it lies.  Returns the bytes used, which is
+// less than len only when the body ended.
+size_t AsyncWebServerRequest::_parseChunked(uint8_t* data, size_t len){
+  size_t i = 0;
+  while(i < len){
+    if(_chunkState == CHUNK_DATA){
+      const size_t n = std::min(len - i, _chunkLeft);
+      _parseBody(data + i, n, false);
+      i += n;
+      _chunkLeft -= n;
+      if(!_chunkLeft) _chunkState = CHUNK_DATA_END;
+      continue;
+    }
+
+    const uint8_t c = data[i++];
+    if(((_chunkState == CHUNK_START) || (_chunkState == CHUNK_SIZE)) && isxdigit(c)){
+      if(_chunkLeft > (SIZE_MAX >> 4)){
+        _rejectHead(400);
+        return len;
+      }
+      _chunkLeft = (_chunkLeft << 4) | (isdigit(c) ? (c - '0') : ((c | 0x20) - 'a' + 10));
+      _chunkState = CHUNK_SIZE;
+    } else if(_chunkState == CHUNK_START){
+      // A size line without a size would otherwise read as the last chunk
+      _rejectHead(400);
+      return len;
+    } else if((_chunkState == CHUNK_SIZE) || (_chunkState == CHUNK_EXTENSION)){
+      if(c != '\n'){
+        _chunkState = CHUNK_EXTENSION;
+      } else if(!_chunkLeft){
+        _chunkState = CHUNK_TRAILER;
+      } else if(_handler && _handler->maxContentLength() && (_parsedLength + _chunkLeft > _handler->maxContentLength())){
+        _rejectHead(413);
+        return len;
+      } else {
+        _chunkState = CHUNK_DATA;
+      }
+    } else if(_chunkState == CHUNK_DATA_END){
+      if(c == '\n'){
+        _chunkState = CHUNK_START;
+      } else if(c != '\r'){
+        _rejectHead(400);
+        return len;
+      }
+    } else if(c == '\n'){
+      if(_chunkState == CHUNK_TRAILER){
+        // Blank line: end of the body
+        _parseBody(data + i, 0, true);
+        _requestReady();
+        return i;
+      }
+      _chunkState = CHUNK_TRAILER;
+    } else if(c != '\r'){
+      _chunkState = CHUNK_TRAILER_LINE;
+    }
+  }
+  return len;
+}
+
+void AsyncWebServerRequest::_parsePlainPost(char* data, size_t len, bool last){
+  // Fields ending inside this packet are decoded where they lie; only a field cut off by the end
+  // of the packet is carried over in _temp.
+  char* end = data + len;
+  while(data < end){
+    char* sep = (char*) memchr(data, '&', end - data);
+    char* nul = (char*) memchr(data, 0, (sep ? sep : end) - data);
+    if(nul) sep = nul;
+    if(!sep){
+      concat(_temp, data, end - data);
+      break;
+    }
+    if(_temp.length()){
+      concat(_temp, data, sep - data);
+      _addPlainPostParam(&_temp[0], _temp.length());
+      _temp = String();
+    } else {
+      _addPlainPostParam(data, sep - data);
     }
-    _addParam(AsyncWebParameter(urlDecode(name), urlDecode(value), true));
+    data = sep + 1;
+  }
+  if(last && _temp.length()){
+    _addPlainPostParam(&_temp[0], _temp.length());
     _temp = String();
   }
 }
 
-void AsyncWebServerRequest::_handleUploadByte(uint8_t data, bool last){
-  _itemBuffer[_itemBufferIndex++] = data;
+// Decodes a "name=value" field in place.  The byte following it may be overwritten.
+void AsyncWebServerRequest::_addPlainPostParam(char* pair, size_t len){
+  if(!len) return;
+  const char* name = "body";
+  char* value = pair;
+  size_t valueLen = len;
+  char* equal = (char*) memchr(pair, '=', len);
+  if((pair[0] != '{') && (pair[0] != '[') && equal && (equal > pair)){
+    pair[_urlDecodeInPlace(pair, equal - pair)] = 0;
+    name = pair;
+    value = equal + 1;
+    valueLen = len - (value - pair);
+  }
+  valueLen = _urlDecodeInPlace(value, valueLen);
+  value[valueLen] = 0;
 
-  if(last || _itemBufferIndex == 1460){
-    //check if authenticated before calling the upload
-    if(_handler)
-      _handler->handleUpload(this, _itemFilename, _itemSize - _itemBufferIndex, _itemBuffer, _itemBufferIndex, false);
-    _itemBufferIndex = 0;
+  if(!_handler || !_handler->handleFormParam(this, name, value, valueLen)){
+    _addParam(AsyncWebParameter(name, value, true));
   }
 }
 
 enum {
-  EXPECT_BOUNDARY,
-  PARSE_HEADERS,
-  WAIT_FOR_RETURN1,
-  EXPECT_FEED1,
-  EXPECT_DASH1,
+  EXPECT_BOUNDARY,    // preamble, before the first delimiter
+  BOUNDARY_TAIL,      // after a delimiter: "--" ends the body, a line break starts a part
   EXPECT_DASH2,
-  BOUNDARY_OR_DATA,
-  DASH3_OR_RETURN2,
-  EXPECT_FEED2,
+  EXPECT_FEED,
+  PARSE_HEADERS,
+  PARSE_VALUE,
   PARSING_FINISHED,
   PARSE_ERROR
 };
 
-void AsyncWebServerRequest::_parseMultipartPostByte(uint8_t data, bool last){
-#define itemWriteByte(b) do { _itemSize++; if(_itemIsFile) _handleUploadByte(b, last); else _itemValue+=(char)(b); } while(0)
+void AsyncWebServerRequest::_multipartData(uint8_t* data, size_t len, bool final){
+  if(_multiParseState != PARSE_VALUE) return;   // preamble is ignored
+  _itemSize += len;
+  if(!_itemIsFile){
+    if(len) concat(_itemValue, (char*) data, len);
+    if(final) _addParam(AsyncWebParameter(_itemName, _itemValue, true));
+  } else if(final){
+    if(_itemSize){
+      _uploadData(data, len, true);
+      _addParam(AsyncWebParameter(_itemName, _itemFilename, true, true, _itemSize));
+    }
+    _server->_returnUploadBuffer(std::move(_itemBuffer));
+    _itemBufferIndex = 0;
+  } else if(len){
+    _uploadData(data, len, false);
+  }
+}
 
-  if(!_parsedLength){
-    _multiParseState = EXPECT_BOUNDARY;
-    _temp = String();
-    _itemName = String();
-    _itemFilename = String();
-    _itemType = String();
+void AsyncWebServerRequest::_uploadData(uint8_t* data, size_t len, bool final){
+  //check if authenticated before calling the upload
+  if(!_handler) return;
+  const size_t chunk = _handler->uploadChunkSize();
+  size_t index = _itemSize - len - _itemBufferIndex;   // of the first byte not yet handed on
+  if(chunk && !index && !_itemBuffer){
+    // Decided once per file: without a buffer, its data is passed on as it arrives.  Staging
+    // from later on would hand on chunks at offsets that aren't multiples of the chunk size.
+    _itemBuffer = _server->_takeUploadBuffer(chunk);
+  }
+  if(!chunk || !_itemBuffer){
+    _handler->handleUpload(this, _itemFilename, index, data, len, final);
+    return;
   }
 
-  if(_multiParseState == WAIT_FOR_RETURN1){
-    if(data != '\r'){
-      itemWriteByte(data);
+  while(len){
+    if(!_itemBufferIndex && (len >= chunk)){
+      // Whole chunks are handed on from where they lie
+      const size_t whole = len - (len % chunk);
+      _handler->handleUpload(this, _itemFilename, index, data, whole, final && (whole == len));
+      if(whole == len) return;
+      index += whole;
+      data += whole;
+      len -= whole;
     } else {
-      _multiParseState = EXPECT_FEED1;
+      const size_t n = std::min(chunk - _itemBufferIndex, len);
+      memcpy(_itemBuffer.data() + _itemBufferIndex, data, n);
+      _itemBufferIndex += n;
+      data += n;
+      len -= n;
+      if(_itemBufferIndex == chunk){
+        _handler->handleUpload(this, _itemFilename, index, (uint8_t*) _itemBuffer.data(), chunk, final && !len);
+        if(final && !len) return;
+        index += chunk;
+        _itemBufferIndex = 0;
+      }
     }
-  } else if(_multiParseState == EXPECT_BOUNDARY){
-    if(_parsedLength < 2 && data != '-'){
-      _multiParseState = PARSE_ERROR;
-      return;
-    } else if(_parsedLength - 2 < _boundary.length() && _boundary.c_str()[_parsedLength - 2] != data){
+  }
+  if(final){
+    _handler->handleUpload(this, _itemFilename, index, (uint8_t*) _itemBuffer.data(), _itemBufferIndex, true);
+  }
+}
+
+void AsyncWebServerRequest::_parseMultipartHeader(){
+  if(_temp.length() > 12 && _temp.substring(0, 12).equalsIgnoreCase(F("Content-Type"))){
+    _itemType = _temp.substring(14);
+    _itemIsFile = true;
+  } else if(_temp.length() > 19 && _temp.substring(0, 19).equalsIgnoreCase(F("Content-Disposition"))){
+    _temp = _temp.substring(_temp.indexOf(';') + 2);
+    while(_temp.indexOf(';') > 0){
+      String name = _temp.substring(0, _temp.indexOf('='));
+      String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.indexOf(';') - 1);
+      if(name == F("name")){
+        _itemName = nameVal;
+      } else if(name == F("filename")){
+        _itemFilename = nameVal;
+        _itemIsFile = true;
+      }
+      _temp = _temp.substring(_temp.indexOf(';') + 2);
+    }
+    String name = _temp.substring(0, _temp.indexOf('='));
+    String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.length() - 1);
+    if(name == F("name")){
+      _itemName = nameVal;
+    } else if(name == F("filename")){
+      _itemFilename = nameVal;
+      _itemIsFile = true;
+    }
+  }
+}
+
+void AsyncWebServerRequest::_parseMultipart(uint8_t* data, size_t len){
+  if(!_multipart){
+    _multiParseState = EXPECT_BOUNDARY;
+    if(!_boundary.length() || (_boundary.length() > ASYNCWEBSERVER_MULTIPART_BOUNDARY_MAX)){
       _multiParseState = PARSE_ERROR;
       return;
-    } else if(_parsedLength - 2 == _boundary.length() && data != '\r'){
+    }
+    _multipart = (AsyncWebMultipartScan*) malloc(sizeof(AsyncWebMultipartScan));
+    if(_multipart == NULL){
       _multiParseState = PARSE_ERROR;
       return;
-    } else if(_parsedLength - 3 == _boundary.length()){
-      if(data != '\n'){
-        _multiParseState = PARSE_ERROR;
+    }
+    _multipart->setup(_boundary);
+  }
+  AsyncWebMultipartScan& scan = *_multipart;
+
+  size_t i = 0;
+  while((i < len) && (_multiParseState < PARSING_FINISHED)){
+    if((_multiParseState == EXPECT_BOUNDARY) || (_multiParseState == PARSE_VALUE)){
+      if(scan.carried){
+        // See whether the bytes held back complete a delimiter with the start of this packet
+        uint8_t window[sizeof(scan.carry) * 2];
+        const size_t carried = scan.carried;
+        const size_t more = std::min(len - i, (size_t) scan.length - 1);
+        memcpy(window, scan.carry, carried);
+        memcpy(window + carried, data + i, more);
+        const size_t found = scan.find(window, carried + more);
+        scan.carried = 0;
+        if(found < carried){
+          _multipartData(window, found, true);
+          i += found + scan.length - carried;
+          _multiParseState = BOUNDARY_TAIL;
+          continue;
+        }
+        const size_t keep = (more == len - i) ? scan.partial(window, carried + more) : (carried + more);
+        if(keep < carried){
+          // Still undecided, and this packet is used up
+          _multipartData(window, keep, false);
+          scan.hold(window + keep, carried + more - keep);
+          return;
+        }
+        _multipartData(window, carried, false);
+      }
+
+      const size_t found = scan.find(data + i, len - i);
+      if(found < len - i){
+        _multipartData(data + i, found, true);
+        i += found + scan.length;
+        _multiParseState = BOUNDARY_TAIL;
+      } else {
+        const size_t keep = scan.partial(data + i, len - i);
+        _multipartData(data + i, keep, false);
+        scan.hold(data + i + keep, len - i - keep);
         return;
       }
-      _multiParseState = PARSE_HEADERS;
-      _itemIsFile = false;
-    }
-  } else if(_multiParseState == PARSE_HEADERS){
-    if((char)data != '\r' && (char)data != '\n')
-       _temp += (char)data;
-    if((char)data == '\n'){
+    } else if(_multiParseState == PARSE_HEADERS){
+      uint8_t* nl = (uint8_t*) memchr(data + i, '\n', len - i);
+      const size_t end = nl ? (size_t) (nl - data) : len;
+      if(end > i) concat(_temp, (char*) data + i, end - i);
+      i = end;
+      if(!nl) return;
+      ++i;
+      if(_temp.length() && (_temp[_temp.length() - 1] == '\r')) _temp.remove(_temp.length() - 1);
       if(_temp.length()){
-        if(_temp.length() > 12 && _temp.substring(0, 12).equalsIgnoreCase(F("Content-Type"))){
-          _itemType = _temp.substring(14);
-          _itemIsFile = true;
-        } else if(_temp.length() > 19 && _temp.substring(0, 19).equalsIgnoreCase(F("Content-Disposition"))){
-          _temp = _temp.substring(_temp.indexOf(';') + 2);
-          while(_temp.indexOf(';') > 0){
-            String name = _temp.substring(0, _temp.indexOf('='));
-            String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.indexOf(';') - 1);
-            if(name == F("name")){
-              _itemName = nameVal;
-            } else if(name == F("filename")){
-              _itemFilename = nameVal;
-              _itemIsFile = true;
-            }
-            _temp = _temp.substring(_temp.indexOf(';') + 2);
-          }
-          String name = _temp.substring(0, _temp.indexOf('='));
-          String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.length() - 1);
-          if(name == F("name")){
-            _itemName = nameVal;
-          } else if(name == F("filename")){
-            _itemFilename = nameVal;
-            _itemIsFile = true;
-          }
-        }
-        _temp = String();
+        _parseMultipartHeader();
       } else {
-        _multiParseState = WAIT_FOR_RETURN1;
         //value starts from here
+        _multiParseState = PARSE_VALUE;
         _itemSize = 0;
-        _itemStartIndex = _parsedLength;
+        _itemStartIndex = _parsedLength + i;
         _itemValue = String();
-        if(_itemIsFile){
-          if(_itemBuffer)
-            free(_itemBuffer);
-          _itemBuffer = (uint8_t*)malloc(1460);
-          if(_itemBuffer == NULL){
-            _multiParseState = PARSE_ERROR;
-            return;
-          }
-          _itemBufferIndex = 0;
-        }
       }
-    }
-  } else if(_multiParseState == EXPECT_FEED1){
-    if(data != '\n'){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); _parseMultipartPostByte(data, last);
+      _temp = String();
     } else {
-      _multiParseState = EXPECT_DASH1;
-    }
-  } else if(_multiParseState == EXPECT_DASH1){
-    if(data != '-'){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n');  _parseMultipartPostByte(data, last);
-    } else {
-      _multiParseState = EXPECT_DASH2;
-    }
-  } else if(_multiParseState == EXPECT_DASH2){
-    if(data != '-'){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  _parseMultipartPostByte(data, last);
-    } else {
-      _multiParseState = BOUNDARY_OR_DATA;
-      _boundaryPosition = 0;
-    }
-  } else if(_multiParseState == BOUNDARY_OR_DATA){
-    if(_boundaryPosition < _boundary.length() && _boundary.c_str()[_boundaryPosition] != data){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  itemWriteByte('-');
-      uint8_t i;
-      for(i=0; i<_boundaryPosition; i++)
-        itemWriteByte(_boundary.c_str()[i]);
-      _parseMultipartPostByte(data, last);
-    } else if(_boundaryPosition == _boundary.length() - 1){
-      _multiParseState = DASH3_OR_RETURN2;
-      if(!_itemIsFile){
-        _addParam(AsyncWebParameter(_itemName, _itemValue, true));
-      } else {
-        if(_itemSize){
-          //check if authenticated before calling the upload
-          if(_handler) _handler->handleUpload(this, _itemFilename, _itemSize - _itemBufferIndex, _itemBuffer, _itemBufferIndex, true);
-          _itemBufferIndex = 0;
-          _addParam(AsyncWebParameter(_itemName, _itemFilename, true, true, _itemSize));
+      const uint8_t c = data[i++];
+      if(_multiParseState == BOUNDARY_TAIL){
+        if(c == '-'){
+          _multiParseState = EXPECT_DASH2;
+        } else if(c == '\r'){
+          _multiParseState = EXPECT_FEED;
+        } else if((c != ' ') && (c != '\t')){
+          _multiParseState = PARSE_ERROR;
         }
-        free(_itemBuffer);
-        _itemBuffer = NULL;
+      } else if(_multiParseState == EXPECT_DASH2){
+        // Anything after the closing delimiter is epilogue, and is ignored
+        _multiParseState = (c == '-') ? PARSING_FINISHED : PARSE_ERROR;
+      } else if(c == '\n'){
+        _multiParseState = PARSE_HEADERS;
+        _itemIsFile = false;
+        _itemName = String();
+        _itemFilename = String();
+        _itemType = String();
+      } else {
+        _multiParseState = PARSE_ERROR;
       }
-
-    } else {
-      _boundaryPosition++;
-    }
-  } else if(_multiParseState == DASH3_OR_RETURN2){
-    if(data == '-' && (_contentLength - _parsedLength - 4) != 0){
-      //os_printf("ERROR: The parser got to the end of the POST but is expecting %u bytes more!\nDrop an issue so we can have more info on the matter!\n", _contentLength - _parsedLength - 4);
-      _contentLength = _parsedLength + 4;//lets close the request gracefully
-    }
-    if(data == '\r'){
-      _multiParseState = EXPECT_FEED2;
-    } else if(data == '-' && _contentLength == (_parsedLength + 4)){
-      _multiParseState = PARSING_FINISHED;
-    } else {
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  itemWriteByte('-');
-      uint8_t i; for(i=0; i<_boundary.length(); i++) itemWriteByte(_boundary.c_str()[i]);
-      _parseMultipartPostByte(data, last);
-    }
-  } else if(_multiParseState == EXPECT_FEED2){
-    if(data == '\n'){
-      _multiParseState = PARSE_HEADERS;
-      _itemIsFile = false;
-    } else {
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  itemWriteByte('-');
-      uint8_t i; for(i=0; i<_boundary.length(); i++) itemWriteByte(_boundary.c_str()[i]);
-      itemWriteByte('\r'); _parseMultipartPostByte(data, last);
     }
   }
 }
 
 void AsyncWebServerRequest::_parseLine(){
+  // Trim the line received since _lineStart and terminate it in place
+  const size_t lineStart = _lineStart;
+  char* head = _head.data();
+  size_t start = _lineStart, end = _headLength;
+  while((end > start) && isspace((unsigned char) head[end-1])) --end;
+  while((start < end) && isspace((unsigned char) head[start])) ++start;
+  head[end] = 0;
+  char* line = head + start;
+  const size_t len = end - start;
+  _headLength = _lineStart = end + 1;
+
   if(_parseState == PARSE_REQ_START){
-    if(!_temp.length()){
+    if(!len && _requestCount){
+      // Tolerate stray CRLFs between requests on a persistent connection
+      _headLength = _lineStart = 0;
+      return;
+    } else if(!len){
       _parseState = PARSE_REQ_FAIL;
       _client->close();
     } else {
-      _parseReqHead();
+      _parseReqHead(line, len);
       _parseState = PARSE_REQ_HEADERS;
     }
     return;
   }
 
   if(_parseState == PARSE_REQ_HEADERS){
-    if(!_temp.length()){
+    if(!len){
       //end of headers
       _server->_rewriteRequest(this);
-      _server->_attachHandler(this);
-      _removeNotInterestingHeaders();
+      if(_method){
+        _server->_attachHandler(this);
+      } else {
+        DEBUG_PRINTFP("(%x) WR unknown method", (intptr_t) this);  // no handler; answered with 501
+      }
+
+      // Decide now whether this connection may carry another request.
+      // HEAD responses still carry a body, so they can't be followed by another request.
+      if(_keepAlive){
+        const size_t maxRequests = _server->getKeepAliveMax();
+        if((_server->getKeepAliveTimeout() == 0)
+            || (maxRequests && (_requestCount + 1 >= maxRequests))
+            || (_method == HTTP_HEAD)
+            || (_reqconntype == RCT_WS) || (_reqconntype == RCT_EVENT)){
+          _keepAlive = false;
+        }
+      }
+
+      // A chunked body's length isn't known up front; it is checked as the chunks arrive
+      if(_chunked) _contentLength = 0;
+      if(_handler && _handler->maxContentLength() && (_contentLength > _handler->maxContentLength())){
+        // Refuse before the client sends the body
+        _rejectHead(413);
+        return;
+      }
 
-      if(_expectingContinue){
-        const static char response[] PROGMEM = "HTTP/1.1 100 Continue\r\n\r\n";
-          char response_stack[sizeof(response)];  // stack, so we can pull it out of flash memory
-          memcpy_P(response_stack, response, sizeof(response));
-        _client->write(response_stack, os_strlen(response_stack));
-      }    
+      if(_expectingContinue && (_contentLength || _chunked)){
+        // Only invite the body if we could handle it now
+        const int status = _server->_continueStatus(this);
+        if(status == 100){
+          _sendContinue();
+        } else if(status){
+          _rejectHead(status);
+          return;
+        } else {
+          // Withheld until the queue gets to us, or the client stops waiting
+          DEBUG_PRINTFP("(%x) WR continue withheld", (intptr_t) this);
+          _setParseState(PARSE_REQ_CONTINUE);
+          return;
+        }
+      }
 
       //check handler for authentication
-      if(_contentLength){
+      if(_contentLength || _chunked){
         _parseState = PARSE_REQ_BODY;
       } else {
         _requestReady();
       }      
-    } else _parseReqHeader();
+    } else if(!_parseReqHeader(line, len)){
+      // Not kept; let the next line reuse the space
+      _headLength = _lineStart = lineStart;
+    }
   }
 }
 
+void AsyncWebServerRequest::_sendContinue() {
+  const static char response[] PROGMEM = "HTTP/1.1 100 Continue\r\n\r\n";
+  char response_stack[sizeof(response)];  // stack, so we can pull it out of flash memory
+  memcpy_P(response_stack, response, sizeof(response));
+  _client->write(response_stack, os_strlen(response_stack));
+  _setParseState(PARSE_REQ_BODY);
+}
+
+void AsyncWebServerRequest::_setParseState(uint8_t state) {
+  _parseState = state;
+  _server->_updateQueue(this);
+}
+
 void AsyncWebServerRequest::_requestReady() {
     //check if authenticated before calling handleRequest and request auth instead
     DEBUG_PRINTFP("(%x) WR handler ready %s", (intptr_t) this, url().c_str());
     if(_handler) {
-      _parseState = PARSE_REQ_QUEUED;
+      _setParseState(PARSE_REQ_QUEUED);
       _server->processQueue();
     }
     else {
-      _parseState = PARSE_REQ_END;
+      _setParseState(PARSE_REQ_END);
       send(501);
     }
 }
@@ -631,134 +1236,273 @@ void AsyncWebServerRequest::_handleRequest() {
   // Shouldn't be possible to land here without a handler
   assert(_handler);
   DEBUG_PRINTFP("(%x) WR handler running", (intptr_t) this);
-  _parseState = PARSE_REQ_END;
+  _setParseState(PARSE_REQ_END);
+  _heapStart = _heapLow = AsyncWebServer::_heapAvailable();
+  _blockStart = _blockLow = AsyncWebServer::_heapLargestBlock();
+  if(_handler->offload() && _server->_offload(this)) return;  // the server finishes us when the worker is done
   _handler->handleRequest(this);
 };
 
-size_t AsyncWebServerRequest::headers() const{
-  return _headers.length();
+void AsyncWebServerRequest::_runOffloaded(void *request) {
+  auto r = static_cast<AsyncWebServerRequest*>(request);
+  r->_handler->handleRequest(r);
 }
 
-bool AsyncWebServerRequest::hasHeader(const String& name) const {
-  for(const auto& h: _headers){
-    if(h.name().equalsIgnoreCase(name)){
-      return true;
+void AsyncWebServerRequest::_finishOffload(bool cancelled) {
+  DEBUG_PRINTFP("(%x) WR back from worker", (intptr_t) this);
+  if(cancelled){
+    // The workers were stopped before getting to us
+    send(503);
+  } else if(_response){
+    // send() only kept it while we were on the worker
+    AsyncWebServerResponse* r = _response;
+    _response = NULL;
+    send(r);
+  } else if(_parseState != PARSE_REQ_DEFERRED){
+    // The handler returned without answering
+    send(500);
+  }
+}
+
+void AsyncWebServerRequest::_sampleHeap() {
+  if(!_heapStart) return;
+  _heapLow = std::min(_heapLow, AsyncWebServer::_heapAvailable());
+  _blockLow = std::min(_blockLow, AsyncWebServer::_heapLargestBlock());
+}
+
+void AsyncWebServerRequest::_endSample() {
+  if(!_heapStart) return;
+  _sampleHeap();
+  if(_handler){
+    _handler->_recordHeapCost(_heapStart - _heapLow, _blockStart - _blockLow);
+    if(_response) _handler->_recordResponseSize(_response->_bytesWritten());
+  }
+  _heapStart = 0;
+}
+
+void AsyncWebServerRequest::_recycle() {
+  // The response has been fully acknowledged; reset the parser so the same client can carry the next request.
+  DEBUG_PRINTFP("(%x) WR recycle", (intptr_t) this);
+  _endSample();
+  if(_response != NULL){
+    AsyncWebServerResponse* r = _response;
+    _response = NULL;
+    delete r;
+  }
+  if(_tempObject != NULL){
+    free(_tempObject);
+    _tempObject = NULL;
+  }
+  if(_tempFile){
+    _tempFile.close();
+  }
+  if(_multipart){
+    free(_multipart);
+    _multipart = NULL;
+  }
+  _server->_returnUploadBuffer(std::move(_itemBuffer));
+
+  _clearHeaders();
+  if(_head.size() > ASYNCWEBSERVER_HEAD_CHUNK){
+    // Don't hold on to a large head buffer while idle
+    _head.clear();
+  }
+  _clearParams();
+  _pathParams.free();
+  _onDisconnectfn = nullptr;
+
+  _handler = NULL;
+  _temp = String();
+  _setParseState(PARSE_REQ_START);
+  _version = 0;
+  _method = HTTP_ANY;
+  _url = String();
+  _host = String();
+  _contentType = String();
+  _boundary = String();
+  _authorization = String();
+  _reqconntype = RCT_HTTP;
+  _isDigest = false;
+  _isMultipart = false;
+  _isPlainPost = false;
+  _expectingContinue = false;
+  _keepAlive = false;
+  _headerChecked = false;
+  _skipHeader = false;
+  _chunked = false;
+  _chunkState = CHUNK_START;
+  _chunkLeft = 0;
+  _lineLength = 0;
+  _headerBytes = 0;
+  _headerCount = 0;
+  _contentLength = 0;
+  _parsedLength = 0;
+  _multiParseState = 0;
+  _itemStartIndex = 0;
+  _itemSize = 0;
+  _itemName = String();
+  _itemFilename = String();
+  _itemType = String();
+  _itemValue = String();
+  _itemBufferIndex = 0;
+  _itemIsFile = false;
+  ++_requestCount;
+
+  _client->setRxTimeout(_server->getKeepAliveTimeout());
+  // We no longer count as active; give any queued request our slot
+  _server->processQueue();
+
+  if(_pipelined.size()){
+    // Start on whatever the client sent while the previous response was in flight
+    DynamicBuffer pending = std::move(_pipelined);
+    _onData(pending.data(), pending.size());
+  }
+}
+
+WebRequestHeader AsyncWebServerRequest::headerId(const char* name, size_t len){
+  const char first = tolower(name[0]);
+  for(size_t i = 0; i < HDR_KNOWN_COUNT; ++i){
+    PGM_P known = KNOWN_HEADER_NAMES[i];
+    if((tolower(pgm_read_byte(known)) == first) && !strncasecmp_P(name, known, len) && !pgm_read_byte(known + len)){
+      return (WebRequestHeader) i;
     }
   }
-  return false;
+  return HDR_UNKNOWN;
 }
 
-bool AsyncWebServerRequest::hasHeader(const __FlashStringHelper * data) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = 0;
-  while (1) {
-    if (pgm_read_byte(p+n) == 0) break;
-      n += 1;
-  }
-  char * name = (char*) malloc(n+1);
-  name[n] = 0; 
-  if (name) {
-    for(size_t b=0; b<n; b++)
-      name[b] = pgm_read_byte(p++);    
-    bool result = hasHeader( String(name) ); 
-    free(name); 
-    return result; 
-  } else {
-    return false; 
+WebRequestHeader AsyncWebServerRequest::headerId(const __FlashStringHelper * name){
+  char buf[sizeof(KNOWN_HEADER_NAMES[0])];
+  PGM_P p = reinterpret_cast<PGM_P>(name);
+  const size_t len = strlen_P(p);
+  if(len >= sizeof(buf)) return HDR_UNKNOWN;  // longer than any known name
+  memcpy_P(buf, p, len + 1);
+  return headerId(buf, len);
+}
+
+const AsyncWebHeaderSlot* AsyncWebServerRequest::_findHeader(WebRequestHeader id) const {
+  return ((id < HDR_KNOWN_COUNT) && _knownHeaders[id].name) ? &_knownHeaders[id] : nullptr;
+}
+
+const AsyncWebHeaderSlot* AsyncWebServerRequest::_findHeader(const char* name) const {
+  const WebRequestHeader id = headerId(name, strlen(name));
+  if(id != HDR_UNKNOWN) return _findHeader(id);
+  for(const auto& slot: _headerSlots){
+    if(!strcasecmp(_head.data() + slot.name, name)){
+      return &slot;
+    }
   }
+  return nullptr;
 }
 
-AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
-  for(auto& h: _headers){
-    if(h.name().equalsIgnoreCase(name)){
-      return const_cast<AsyncWebHeader*>(&h); // maintain previous interface
+const AsyncWebHeaderSlot* AsyncWebServerRequest::_findHeader_P(PGM_P name) const {
+  const WebRequestHeader id = headerId(reinterpret_cast<const __FlashStringHelper*>(name));
+  if(id != HDR_UNKNOWN) return _findHeader(id);
+  for(const auto& slot: _headerSlots){
+    if(!strcasecmp_P(_head.data() + slot.name, name)){
+      return &slot;
     }
   }
   return nullptr;
 }
 
-AsyncWebHeader* AsyncWebServerRequest::getHeader(const __FlashStringHelper * data) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = strlen_P(p); 
-  char * name = (char*) malloc(n+1);
-  if (name) {
-    strcpy_P(name, p); 
-    AsyncWebHeader* result = getHeader( String(name)); 
-    free(name); 
-    return result; 
-  } else {
-    return nullptr; 
+const AsyncWebHeaderSlot* AsyncWebServerRequest::_nthHeader(size_t num) const {
+  // Well-known headers first, then the rest in arrival order
+  for(const auto& slot: _knownHeaders){
+    if(slot.name && !num--) return &slot;
   }
+  return (num < _headerSlots.size()) ? &_headerSlots[num] : nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::_materializeHeader(const AsyncWebHeaderSlot& slot) const {
+  // Headers are only copied in to Strings when somebody asks for the object
+  if(!slot.header){
+    slot.header = new AsyncWebHeader(String(_head.data() + slot.name), String(_head.data() + slot.value));
+  }
+  return slot.header;
+}
+
+size_t AsyncWebServerRequest::headers() const{
+  size_t count = _headerSlots.size();
+  for(const auto& slot: _knownHeaders){
+    if(slot.name) ++count;
+  }
+  return count;
+}
+
+bool AsyncWebServerRequest::hasHeader(const String& name) const {
+  return _findHeader(name.c_str()) != nullptr;
+}
+
+bool AsyncWebServerRequest::hasHeader(const __FlashStringHelper * data) const {
+  return _findHeader_P(reinterpret_cast<PGM_P>(data)) != nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
+  const AsyncWebHeaderSlot* slot = _findHeader(name.c_str());
+  return slot ? _materializeHeader(*slot) : nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const __FlashStringHelper * data) const {
+  const AsyncWebHeaderSlot* slot = _findHeader_P(reinterpret_cast<PGM_P>(data));
+  return slot ? _materializeHeader(*slot) : nullptr;
 }
 
 AsyncWebHeader* AsyncWebServerRequest::getHeader(size_t num) const {
-  return const_cast<AsyncWebHeader*>(_headers.nth(num));  // maintain previous interface
+  const AsyncWebHeaderSlot* slot = _nthHeader(num);
+  return slot ? _materializeHeader(*slot) : nullptr;
+}
+
+bool AsyncWebServerRequest::hasHeader(WebRequestHeader id) const {
+  return _findHeader(id) != nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(WebRequestHeader id) const {
+  const AsyncWebHeaderSlot* slot = _findHeader(id);
+  return slot ? _materializeHeader(*slot) : nullptr;
+}
+
+const char* AsyncWebServerRequest::headerValue(WebRequestHeader id) const {
+  const AsyncWebHeaderSlot* slot = _findHeader(id);
+  return slot ? (_head.data() + slot->value) : nullptr;
 }
 
 size_t AsyncWebServerRequest::params() const {
-  return _params.length();
+  _parseQuery();
+  return _paramIndex.size();
 }
 
 bool AsyncWebServerRequest::hasParam(const String& name, bool post, bool file) const {
-  for(const auto& p: _params){
-    if(p.name() == name && p.isPost() == post && p.isFile() == file){
-      return true;
-    }
-  }
-  return false;
+  return _findParam(name.c_str(), name.length(), false, post, file) != nullptr;
 }
 
 bool AsyncWebServerRequest::hasParam(const __FlashStringHelper * data, bool post, bool file) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = strlen_P(p);
-
-  char * name = (char*) malloc(n+1);
-  name[n] = 0; 
-  if (name) {
-    strcpy_P(name,p);    
-    bool result = hasParam( name, post, file); 
-    free(name); 
-    return result; 
-  } else {
-    return false; 
-  }
+  return _findParam_P(reinterpret_cast<PGM_P>(data), false, post, file) != nullptr;
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) const {
-  for(const auto& p: _params){
-    if(p.name() == name && p.isPost() == post && p.isFile() == file){
-      return const_cast<AsyncWebParameter*>(&p);  // maintain previous interface
-    }
-  }
-  return nullptr;
+  return const_cast<AsyncWebParameter*>(_findParam(name.c_str(), name.length(), false, post, file));  // maintain previous interface
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(const __FlashStringHelper * data, bool post, bool file) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = strlen_P(p);
-  char * name = (char*) malloc(n+1);
-  if (name) {
-    strcpy_P(name, p);   
-    AsyncWebParameter* result = getParam(name, post, file); 
-    free(name); 
-    return result; 
-  } else {
-    return nullptr; 
-  }
+  return const_cast<AsyncWebParameter*>(_findParam_P(reinterpret_cast<PGM_P>(data), false, post, file));
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(size_t num) const {
-  return const_cast<AsyncWebParameter*>(_params.nth(num));  // maintain previous interface
+  _parseQuery();
+  return (num < _paramIndex.size()) ? const_cast<AsyncWebParameter*>(_paramIndex[num].param) : nullptr;  // maintain previous interface
 }
 
 void AsyncWebServerRequest::addInterestingHeader(const String& name){
-  if(!_interestingHeaders.containsIgnoreCase(name))
-    _interestingHeaders.add(name);
+  // Headers are filtered while they are received, using the declarations collected from the
+  // handlers (AsyncWebHandler::addInterestingHeader); by the time a handler is asked it is too late.
+  (void)name;
 }
 
 void AsyncWebServerRequest::send(AsyncWebServerResponse *response){
   DEBUG_PRINTFP("(%x) WR added response %x",(intptr_t)this, (intptr_t)response);
   _response = response;
+  _sampleHeap();    // with the response built
+  if(_offloaded) return;  // on a worker; sent from the network side when the handler returns
   if(_response == NULL){
     _client->close(true);
     _onDisconnect();
@@ -770,6 +1514,7 @@ void AsyncWebServerRequest::send(AsyncWebServerResponse *response){
     send(500);
   }
   else {
+    if(_keepAlive && !_response->_keepAliveSupported()) _keepAlive = false;
     _client->setRxTimeout(0);
     _response->_respond(this);
   }
@@ -912,51 +1657,21 @@ void AsyncWebServerRequest::requestAuthentication(const char * realm, bool isDig
 }
 
 bool AsyncWebServerRequest::hasArg(const char* name) const {
-  for(const auto& arg: _params){
-    if(arg.name() == name){
-      return true;
-    }
-  }
-  return false;
+  return _findParam(name, strlen(name), true) != nullptr;
 }
 
 bool AsyncWebServerRequest::hasArg(const __FlashStringHelper * data) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = strlen_P(p); 
-  char * name = (char*) malloc(n+1);
-  if (name) {
-    strcpy_P(name, p);    
-    bool result = hasArg( name ); 
-    free(name); 
-    return result; 
-  } else {
-    return false; 
-  }
+  return _findParam_P(reinterpret_cast<PGM_P>(data), true) != nullptr;
 }
 
-
 const String& AsyncWebServerRequest::arg(const String& name) const {
-  for(const auto& arg: _params){
-    if(arg.name() == name){
-      return arg.value();
-    }
-  }
-  return SharedEmptyString;
+  const AsyncWebParameter* p = _findParam(name.c_str(), name.length(), true);
+  return p ? p->value() : SharedEmptyString;
 }
 
 const String& AsyncWebServerRequest::arg(const __FlashStringHelper * data) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = strlen_P(p);
-  char * name = (char*) malloc(n+1);
-  if (name) {
-    strcpy_P(name, p);
-    const String & result = arg( String(name) ); 
-    free(name); 
-    return result; 
-  } else {
-    return SharedEmptyString;
-  }
-
+  const AsyncWebParameter* p = _findParam_P(reinterpret_cast<PGM_P>(data), true);
+  return p ? p->value() : SharedEmptyString;
 }
 
 const String& AsyncWebServerRequest::arg(size_t i) const {
@@ -973,23 +1688,14 @@ const String& AsyncWebServerRequest::pathArg(size_t i) const {
 }
 
 const String& AsyncWebServerRequest::header(const char* name) const {
-  AsyncWebHeader* h = getHeader(String(name));
-  return h ? h->value() : SharedEmptyString;
+  const AsyncWebHeaderSlot* slot = _findHeader(name);
+  return slot ? _materializeHeader(*slot)->value() : SharedEmptyString;
 }
 
 const String& AsyncWebServerRequest::header(const __FlashStringHelper * data) const {
-  PGM_P p = reinterpret_cast<PGM_P>(data);
-  size_t n = strlen_P(p); 
-  char * name = (char*) malloc(n+1);
-  if (name) {
-    strcpy_P(name, p);  
-    const String & result = header( (const char *)name ); 
-    free(name); 
-    return result; 
-  } else {
-    return SharedEmptyString; 
-  }
-};  
+  const AsyncWebHeaderSlot* slot = _findHeader_P(reinterpret_cast<PGM_P>(data));
+  return slot ? _materializeHeader(*slot)->value() : SharedEmptyString;
+}
 
 
 const String& AsyncWebServerRequest::header(size_t i) const {
@@ -997,23 +1703,49 @@ const String& AsyncWebServerRequest::header(size_t i) const {
   return h ?  h->value() : SharedEmptyString;
 }
 
+const String& AsyncWebServerRequest::header(WebRequestHeader id) const {
+  AsyncWebHeader* h = getHeader(id);
+  return h ?  h->value() : SharedEmptyString;
+}
+
 const String& AsyncWebServerRequest::headerName(size_t i) const {
   AsyncWebHeader* h = getHeader(i);
   return h ? h->name() : SharedEmptyString;
 }
 
 String AsyncWebServerRequest::urlDecode(const String& text) const {
+  return _urlDecode(text.c_str(), text.length());
+}
+
+size_t AsyncWebServerRequest::_urlDecodeInPlace(char* text, size_t len) {
+  // Decoded text is never longer than the source, so it can overwrite it
+  char temp[] = "0x00";
+  size_t i = 0, out = 0;
+  while (i < len){
+    char decodedChar = text[i++];
+    if ((decodedChar == '%') && (i + 1 < len)){
+      temp[2] = text[i++];
+      temp[3] = text[i++];
+      decodedChar = strtol(temp, NULL, 16);
+    } else if (decodedChar == '+') {
+      decodedChar = ' ';
+    }
+    text[out++] = decodedChar;
+  }
+  return out;
+}
+
+String AsyncWebServerRequest::_urlDecode(const char* text, size_t len) {
   char temp[] = "0x00";
-  unsigned int len = text.length();
-  unsigned int i = 0;
+  size_t i = 0;
   String decoded = String();
   decoded.reserve(len); // Allocate the string internal buffer - never longer from source text
   while (i < len){
     char decodedChar;
-    char encodedChar = text.charAt(i++);
+    char encodedChar = text[i++];
     if ((encodedChar == '%') && (i + 1 < len)){
-      temp[2] = text.charAt(i++);
-      temp[3] = text.charAt(i++);
+      temp[2] = text[i++];
+      temp[3] = text[i++];
       decodedChar = strtol(temp, NULL, 16);
     } else if (encodedChar == '+') {
       decodedChar = ' ';
@@ -1060,6 +1792,6 @@ bool AsyncWebServerRequest::isExpectedRequestedConnType(RequestedConnectionType
 void AsyncWebServerRequest::deferResponse() {
   // Ask the server to put us on the back of the queue
   DEBUG_PRINTFP("(%x) WR defer", (intptr_t) this);
-  _parseState = PARSE_REQ_DEFERRED;
+  _setParseState(PARSE_REQ_DEFERRED);
   // Queue processing loop will handle it from here
 }
\ No newline at end of file
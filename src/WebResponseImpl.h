@@ -27,6 +27,7 @@
 #undef min
 #undef max
 #endif
+#include <vector>
 #include "DynamicBuffer.h"
 
 class AsyncBasicResponse: public AsyncWebServerResponse {
@@ -39,14 +40,39 @@ class AsyncBasicResponse: public AsyncWebServerResponse {
     bool _sourceValid() const { return true; }
 };
 
+// A single byte range of the content, as requested by a Range header
+struct AsyncWebRange {
+  size_t start;
+  size_t end;   // inclusive
+};
+
+// Body generation state for a multipart/byteranges response
+struct AsyncWebRangeParts {
+  std::vector<AsyncWebRange> ranges;
+  String boundary;
+  String contentType;   // type of the underlying content
+  size_t total;         // length of the underlying content
+  size_t next;          // next part to start; ranges.size() is the closing delimiter
+  String head;          // part header currently being sent
+  size_t headSent;
+  size_t left;          // content bytes left in the current part
+};
+
 class AsyncAbstractResponse: public AsyncWebServerResponse {
   private:
     String _head;
     Walkable<DynamicBuffer> _packet, _cache;
+    std::unique_ptr<AsyncWebRangeParts> _rangeParts;
     size_t _readDataFromCacheOrContent(uint8_t* data, const size_t len);
     size_t _fillBufferAndProcessTemplates(uint8_t* buf, size_t maxLen);
+    void _setupRanges(AsyncWebServerRequest *request);
+    bool _rangeValidatorMatches(const char* validator) const;
+    size_t _fillRangeParts(uint8_t* data, size_t len);
   protected:
     AwsTemplateProcessor _callback;
+    // Responses that can reposition their source support Range requests
+    virtual bool _supportsRanges() const { return false; }
+    virtual bool _seekContent(size_t pos __attribute__((unused))) { return false; }
   public:
     AsyncAbstractResponse(AwsTemplateProcessor callback=nullptr);
     void _respond(AsyncWebServerRequest *request);
@@ -73,6 +99,9 @@ class AsyncFileResponse: public AsyncAbstractResponse {
     ~AsyncFileResponse();
     bool _sourceValid() const { return !!(_content); }
     virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+  protected:
+    virtual bool _supportsRanges() const override { return true; }
+    virtual bool _seekContent(size_t pos) override { return _content.seek(pos, fs::SeekSet); }
 };
 
 class AsyncStreamResponse: public AsyncAbstractResponse {
@@ -107,11 +136,15 @@ class AsyncChunkedResponse: public AsyncAbstractResponse {
 class AsyncProgmemResponse: public AsyncAbstractResponse {
   private:
     const uint8_t * _content;
+    size_t _length;
     size_t _readLength;
   public:
     AsyncProgmemResponse(int code, const String& contentType, const uint8_t * content, size_t len, AwsTemplateProcessor callback=nullptr);
     bool _sourceValid() const { return true; }
     virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+  protected:
+    virtual bool _supportsRanges() const override { return true; }
+    virtual bool _seekContent(size_t pos) override;
 };
 
 class AsyncResponseStream: public AsyncAbstractResponse, public Print {
@@ -87,6 +87,7 @@ AsyncWebServerResponse::AsyncWebServerResponse()
   , _contentLength(0)
   , _sendContentLength(true)
   , _chunked(false)
+  , _acceptRanges(false)
   , _headLength(0)
   , _sentLength(0)
   , _ackedLength(0)
@@ -167,7 +168,7 @@ String AsyncWebServerResponse::_assembleHead(uint8_t version){
   _headers.free();
 
   if(version) {
-    out.concat(F("Accept-Ranges: none\r\n"));
+    out.concat(_acceptRanges ? F("Accept-Ranges: bytes\r\n") : F("Accept-Ranges: none\r\n"));
     if(_chunked) {
       out.concat(F("Transfer-Encoding: chunked\r\n"));
     }
@@ -197,10 +198,10 @@ AsyncBasicResponse::AsyncBasicResponse(int code, String contentType, String cont
     if(!_contentType.length())
       _contentType = FPSTR(CONTENT_TYPE_PLAIN);
   }
-  addHeader(F("Connection"),F("close"));
 }
 
 void AsyncBasicResponse::_respond(AsyncWebServerRequest *request){
+  addHeader(F("Connection"), request->keepAlive() ? F("keep-alive") : F("close"));
   _state = RESPONSE_HEADERS;
   String out = _assembleHead(request->version());
   size_t outLen = out.length();
@@ -277,13 +278,180 @@ AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback): _ca
 }
 
 void AsyncAbstractResponse::_respond(AsyncWebServerRequest *request){
-  addHeader(F("Connection"),F("close"));
+  addHeader(F("Connection"), request->keepAlive() ? F("keep-alive") : F("close"));
+  _setupRanges(request);
   _head = _assembleHead(request->version());
   _state = RESPONSE_HEADERS;
   _ack(request, 0, 0);
 }
 
 
+#ifndef ASYNCWEBSERVER_MAX_RANGES
+#define ASYNCWEBSERVER_MAX_RANGES 8
+#endif
+
+// Parse a Range header value (RFC 7233) against content of the given length.
+// Returns the number of satisfiable ranges, or -1 if the header should be ignored.
+static int parse_byte_ranges(const char* spec, size_t total, std::vector<AsyncWebRange>& ranges) {
+  if (strncasecmp_P(spec, PSTR("bytes="), 6) != 0) return -1;
+  spec += 6;
+  while (*spec) {
+    while ((*spec == ' ') || (*spec == ',')) ++spec;
+    if (!*spec) break;
+
+    char* endp;
+    const bool hasStart = isdigit(*spec);
+    size_t start = 0, end = total ? total - 1 : 0;
+    if (hasStart) {
+      start = strtoul(spec, &endp, 10);
+      spec = endp;
+    }
+    while (*spec == ' ') ++spec;
+    if (*spec++ != '-') return -1;
+    while (*spec == ' ') ++spec;
+
+    bool satisfiable = true;
+    if (isdigit(*spec)) {
+      size_t value = strtoul(spec, &endp, 10);
+      spec = endp;
+      if (hasStart) {
+        if (value < start) return -1;
+        end = std::min(value, end);
+      } else {
+        // suffix range: last 'value' bytes
+        satisfiable = (value > 0);
+        start = (value >= total) ? 0 : total - value;
+      }
+    } else if (!hasStart) {
+      return -1;
+    }
+    while (*spec == ' ') ++spec;
+    if (*spec && (*spec != ',')) return -1;
+
+    if (satisfiable && (start < total)) {
+      if (ranges.size() == ASYNCWEBSERVER_MAX_RANGES) return -1;  // not worth the effort; send it all
+      ranges.push_back({start, end});
+    }
+  }
+  return ranges.size();
+}
+
+static String range_part_head(const AsyncWebRangeParts& parts, size_t index) {
+  String out = F("\r\n--");
+  out.concat(parts.boundary);
+  if (index == parts.ranges.size()) {
+    out.concat(F("--\r\n"));
+    return out;
+  }
+  char buf[48];
+  const auto& r = parts.ranges[index];
+  snprintf_P(buf, sizeof(buf), PSTR("bytes %u-%u/%u\r\n\r\n"), (unsigned) r.start, (unsigned) r.end, (unsigned) parts.total);
+  out.concat(F("\r\nContent-Type: "));
+  out.concat(parts.contentType);
+  out.concat(F("\r\nContent-Range: "));
+  out.concat(buf);
+  return out;
+}
+
+bool AsyncAbstractResponse::_rangeValidatorMatches(const char* validator) const {
+  for(const auto& header: _headers){
+    if((header.name().equalsIgnoreCase(F("ETag")) || header.name().equalsIgnoreCase(F("Last-Modified"))) && header.value() == validator){
+      return true;
+    }
+  }
+  return false;
+}
+
+void AsyncAbstractResponse::_setupRanges(AsyncWebServerRequest *request){
+  // Templates change the length, and we need to know it to address bytes
+  if(!_supportsRanges() || _callback || _chunked || !_sendContentLength) return;
+  _acceptRanges = true;
+  if((_code != 200) || ((request->method() != HTTP_GET) && (request->method() != HTTP_HEAD))) return;
+
+  const char* range = request->headerValue(HDR_RANGE);
+  if(!range) return;
+  const char* ifRange = request->headerValue(HDR_IF_RANGE);
+  if(ifRange && !_rangeValidatorMatches(ifRange)) return;  // content changed, send all of it
+
+  const size_t total = _contentLength;
+  std::vector<AsyncWebRange> ranges;
+  int count = parse_byte_ranges(range, total, ranges);
+  if(count < 0) return;
+
+  char buf[48];
+  if(count == 0){
+    _code = 416;
+    snprintf_P(buf, sizeof(buf), PSTR("bytes */%u"), (unsigned) total);
+    addHeader(F("Content-Range"), buf);
+    _contentLength = 0;
+    return;
+  }
+
+  if(count == 1){
+    const auto& r = ranges.front();
+    if(!_seekContent(r.start)) return;
+    _code = 206;
+    snprintf_P(buf, sizeof(buf), PSTR("bytes %u-%u/%u"), (unsigned) r.start, (unsigned) r.end, (unsigned) total);
+    addHeader(F("Content-Range"), buf);
+    _contentLength = r.end - r.start + 1;
+    return;
+  }
+
+  std::unique_ptr<AsyncWebRangeParts> parts(new AsyncWebRangeParts());
+  if(!parts) return;
+  parts->ranges = std::move(ranges);
+  snprintf_P(buf, sizeof(buf), PSTR("ESPAsyncWebServer%08x"), (unsigned) (((uintptr_t) this) ^ millis()));
+  parts->boundary = buf;
+  parts->contentType = _contentType;
+  parts->total = total;
+  parts->next = 0;
+  parts->headSent = 0;
+  parts->left = 0;
+
+  size_t length = 0;
+  for(size_t i = 0; i <= parts->ranges.size(); ++i){
+    length += range_part_head(*parts, i).length();
+    if(i < parts->ranges.size()) length += parts->ranges[i].end - parts->ranges[i].start + 1;
+  }
+
+  _code = 206;
+  _contentType = F("multipart/byteranges; boundary=");
+  _contentType.concat(parts->boundary);
+  _contentLength = length;
+  _rangeParts = std::move(parts);
+}
+
+size_t AsyncAbstractResponse::_fillRangeParts(uint8_t* data, size_t len){
+  auto& parts = *_rangeParts;
+  size_t filled = 0;
+  while(filled < len){
+    if(parts.headSent < parts.head.length()){
+      const size_t n = std::min(len - filled, (size_t) (parts.head.length() - parts.headSent));
+      memcpy(data + filled, parts.head.c_str() + parts.headSent, n);
+      parts.headSent += n;
+      filled += n;
+    } else if(parts.left){
+      const size_t n = _fillBuffer(data + filled, std::min(len - filled, parts.left));
+      if((n == RESPONSE_TRY_AGAIN) || (n == 0)) break;
+      parts.left -= n;
+      filled += n;
+    } else if(parts.next <= parts.ranges.size()){
+      // Start the next part
+      const size_t index = parts.next++;
+      parts.head = range_part_head(parts, index);
+      parts.headSent = 0;
+      if(index < parts.ranges.size()){
+        const auto& r = parts.ranges[index];
+        if(!_seekContent(r.start)) break;
+        parts.left = r.end - r.start + 1;
+      }
+    } else {
+      break;  // all done
+    }
+  }
+  return filled;
+}
+
 static size_t _max_heap_alloc() {
   auto result = 
 #ifdef ESP8266
@@ -463,7 +631,7 @@ size_t AsyncAbstractResponse::_readDataFromCacheOrContent(uint8_t* data, const s
     // If we need to read more...
     if (len > readFromCache) {
       const size_t needFromFile = len - readFromCache;
-      const size_t readFromContent = _fillBuffer(data + readFromCache, needFromFile);
+      const size_t readFromContent = _rangeParts ? _fillRangeParts(data + readFromCache, needFromFile) : _fillBuffer(data + readFromCache, needFromFile);
       if (readFromContent != RESPONSE_TRY_AGAIN) {
         _sentLength += readFromContent;
         return readFromCache + readFromContent;
@@ -501,7 +669,7 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
     // If closing placeholder is found:
     if(pTemplateEnd) {
       // prepare argument to callback
-      const size_t paramNameLength = std::min(sizeof(buf) - 1, (unsigned int)(pTemplateEnd - pTemplateStart - 1));
+      const size_t paramNameLength = std::min(sizeof(buf) - 1, (size_t)(pTemplateEnd - pTemplateStart - 1));
       if(paramNameLength) {
         memcpy(buf, pTemplateStart + 1, paramNameLength);
         buf[paramNameLength] = 0;
@@ -710,11 +878,18 @@ AsyncProgmemResponse::AsyncProgmemResponse(int code, const String& contentType,
   _content = content;
   _contentType = contentType;
   _contentLength = len;
+  _length = len;
   _readLength = 0;
 }
 
+bool AsyncProgmemResponse::_seekContent(size_t pos){
+  if(pos > _length) return false;
+  _readLength = pos;
+  return true;
+}
+
 size_t AsyncProgmemResponse::_fillBuffer(uint8_t *data, size_t len){
-  size_t left = _contentLength - _readLength;
+  size_t left = _length - _readLength;
   if (left > len) {
     memcpy_P(data, _content + _readLength, len);
     _readLength += len;
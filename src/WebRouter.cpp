@@ -0,0 +1,248 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ESPAsyncWebServer.h"
+#include <algorithm>
+
+uint32_t AsyncWebRoute::_revision = 0;
+
+// If p starts a "{name}" segment, returns the closing brace
+static const char* param_end(const char* p){
+  if((p[0] != '{') || (p[-1] != '/')) return nullptr;
+  const char* close = strchr(p, '}');
+  if(!close || ((close[1] != '/') && (close[1] != 0))) return nullptr;
+  return close;
+}
+
+// End of the path segment starting at p
+static const char* segment_end(const char* p){
+  while(*p && (*p != '/')) ++p;
+  return p;
+}
+
+void AsyncWebRoute::set(const String& uri){
+  _uri = uri;
+  _pattern = String();
+  _hasParams = false;
+#ifdef ASYNCWEBSERVER_REGEX
+  _regex = std::regex();
+#endif
+  ++_revision;
+
+  if(_uri.startsWith("^") && _uri.endsWith("$")){
+#ifdef ASYNCWEBSERVER_REGEX
+    _kind = ROUTE_REGEX;
+    _regex.assign(_uri.c_str(), _uri.length());
+#else
+    _kind = ROUTE_OTHER;
+#endif
+  } else if(!_uri.length()){
+    _kind = ROUTE_ANY;
+  } else if(_uri.startsWith("/*.")){
+    _kind = ROUTE_EXTENSION;
+    _pattern = _uri.substring(_uri.lastIndexOf('.'));
+  } else if(_uri.endsWith("*")){
+    _kind = ROUTE_PREFIX;
+    _pattern = _uri.substring(0, _uri.length() - 1);
+  } else if(_uri[0] == '/'){
+    _kind = ROUTE_PATH;
+    for(const char* p = _uri.c_str(); *p; ++p){
+      if(param_end(p)) _hasParams = true;
+    }
+  } else {
+    _kind = ROUTE_OTHER;
+  }
+}
+
+bool AsyncWebRoute::match(AsyncWebServerRequest *request) const {
+  const String& url = request->url();
+  switch(_kind){
+    case ROUTE_ANY:
+      return true;
+    case ROUTE_EXTENSION:
+      return url.endsWith(_pattern);
+    case ROUTE_PREFIX:
+      return url.startsWith(_pattern);
+#ifdef ASYNCWEBSERVER_REGEX
+    case ROUTE_REGEX: {
+      std::cmatch matches;
+      if(!std::regex_search(url.c_str(), url.c_str() + url.length(), matches, _regex)) return false;
+      for(size_t i = 1; i < matches.size(); ++i){ // start from 1
+        request->_addPathParam(matches[i].first, matches[i].length());
+      }
+      return true;
+    }
+#endif
+    default:
+      break;
+  }
+
+  if(!_hasParams){
+    // The uri itself, or anything below it
+    return url.startsWith(_uri) && ((url.length() == _uri.length()) || (url[_uri.length()] == '/'));
+  }
+
+  // Walk the uri and url together, noting where the {params} fall
+  struct { const char* start; size_t len; } captures[ASYNCWEBSERVER_MAX_PATH_PARAMS];
+  size_t count = 0;
+  const char* p = _uri.c_str();
+  const char* u = url.c_str();
+  while(*p){
+    const char* close = param_end(p);
+    if(close){
+      const char* end = segment_end(u);
+      if((end == u) || (count == ASYNCWEBSERVER_MAX_PATH_PARAMS)) return false;
+      captures[count++] = { u, (size_t) (end - u) };
+      u = end;
+      p = close + 1;
+    } else if(*p++ != *u++){
+      return false;
+    }
+  }
+  if(*u && (*u != '/')) return false;
+
+  for(size_t i = 0; i < count; ++i){
+    request->_addPathParam(captures[i].start, captures[i].len);
+  }
+  return true;
+}
+
+AsyncWebRouter::Node::~Node(){
+  for(auto child: children) delete child;
+  delete param;
+}
+
+void AsyncWebRouter::clear(){
+  for(auto child: _root.children) delete child;
+  _root.children.clear();
+  delete _root.param;
+  _root.param = nullptr;
+  _root.handlers.clear();
+  _root.prefixes.clear();
+  _extensions.clear();
+  _unrouted.clear();
+}
+
+AsyncWebRouter::Node* AsyncWebRouter::_child(Node& node, const char* segment, size_t len, bool param){
+  if(param){
+    if(!node.param) node.param = new Node();
+    return node.param;
+  }
+  for(auto child: node.children){
+    if((child->segment.length() == len) && !memcmp(child->segment.c_str(), segment, len)) return child;
+  }
+  Node* child = new Node();
+  child->segment = String(segment).substring(0, len);
+  node.children.push_back(child);
+  return child;
+}
+
+void AsyncWebRouter::add(AsyncWebHandler* handler, size_t order){
+  const Entry entry { order, handler };
+  const AsyncWebRoute* route = handler->route();
+  if(!route){
+    _unrouted.push_back(entry);
+    return;
+  }
+
+  switch(route->kind()){
+    case AsyncWebRoute::ROUTE_ANY:
+      _root.prefixes.push_back(Tail { String(), entry });
+      break;
+    case AsyncWebRoute::ROUTE_EXTENSION:
+      _extensions.push_back(Extension { route->pattern(), entry });
+      break;
+    case AsyncWebRoute::ROUTE_PREFIX: {
+      // Descend through the complete segments; the partial one left over is compared as a string
+      Node* node = &_root;
+      const char* p = route->pattern().c_str();
+      while(*p == '/'){
+        const char* end = segment_end(p + 1);
+        if(!*end) break;
+        node = _child(*node, p + 1, end - p - 1, false);
+        p = end;
+      }
+      node->prefixes.push_back(Tail { String(p), entry });
+      break;
+    }
+    case AsyncWebRoute::ROUTE_PATH: {
+      Node* node = &_root;
+      const char* p = route->uri().c_str();
+      while(*p == '/'){
+        const char* end = segment_end(p + 1);
+        node = _child(*node, p + 1, end - p - 1, param_end(p + 1) != nullptr);
+        p = end;
+      }
+      node->handlers.push_back(entry);
+      break;
+    }
+    default:
+      _unrouted.push_back(entry);
+      break;
+  }
+}
+
+void AsyncWebRouter::_collect(const Node& node, const char* rest){
+  for(const auto& prefix: node.prefixes){
+    if(!strncmp(rest, prefix.tail.c_str(), prefix.tail.length())) _matches.push_back(prefix.entry);
+  }
+  for(const auto& entry: node.handlers){
+    _matches.push_back(entry);
+  }
+  if(*rest != '/') return;
+
+  const char* segment = rest + 1;
+  const char* end = segment_end(segment);
+  const size_t len = end - segment;
+  for(const auto child: node.children){
+    if((child->segment.length() == len) && !memcmp(child->segment.c_str(), segment, len)){
+      _collect(*child, end);
+      break;
+    }
+  }
+  if(node.param && len) _collect(*node.param, end);
+}
+
+const std::vector<AsyncWebHandler*>& AsyncWebRouter::candidates(const char* url){
+  _matches.clear();
+  _collect(_root, url);
+  if(_extensions.size()){
+    const char* dot = strrchr(url, '.');
+    if(dot){
+      for(const auto& ext: _extensions){
+        if(!strcmp(dot, ext.extension.c_str())) _matches.push_back(ext.entry);
+      }
+    }
+  }
+  std::sort(_matches.begin(), _matches.end(), [](const Entry& a, const Entry& b){ return a.order < b.order; });
+
+  // Merge with the handlers that are asked about every url
+  _candidates.clear();
+  auto m = _matches.begin();
+  auto u = _unrouted.begin();
+  while((m != _matches.end()) || (u != _unrouted.end())){
+    if((u == _unrouted.end()) || ((m != _matches.end()) && (m->order < u->order))){
+      _candidates.push_back((m++)->handler);
+    } else {
+      _candidates.push_back((u++)->handler);
+    }
+  }
+  return _candidates;
+}
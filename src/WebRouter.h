@@ -0,0 +1,125 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBSERVERROUTER_H_
+#define ASYNCWEBSERVERROUTER_H_
+
+// Included from ESPAsyncWebServer.h
+
+#ifdef ASYNCWEBSERVER_REGEX
+#include <regex>
+#endif
+
+#ifndef ASYNCWEBSERVER_MAX_PATH_PARAMS
+#define ASYNCWEBSERVER_MAX_PATH_PARAMS 8
+#endif
+
+/*
+ * ROUTE :: A handler uri, classified once so it can be matched without temporaries
+ * */
+
+//   ""            every url
+//   "/a/b"        "/a/b" and anything below it
+//   "/a/{id}/b"   as above; {id} matches one segment, captured as a path arg
+//   "/a*"         every url starting with "/a"
+//   "/*.ext"      every url ending with ".ext"
+//   "^...$"       regex, compiled once; groups are captured as path args (ASYNCWEBSERVER_REGEX only)
+
+class AsyncWebRoute {
+  public:
+    typedef enum { ROUTE_ANY, ROUTE_PATH, ROUTE_PREFIX, ROUTE_EXTENSION, ROUTE_REGEX, ROUTE_OTHER } RouteKind;
+
+  private:
+    String _uri;
+    String _pattern;    // prefix or extension to compare against
+    RouteKind _kind;
+    bool _hasParams;
+#ifdef ASYNCWEBSERVER_REGEX
+    std::regex _regex;
+#endif
+    static uint32_t _revision;
+
+  public:
+    AsyncWebRoute() : _uri(), _pattern(), _kind(ROUTE_ANY), _hasParams(false) {}
+    void set(const String& uri);
+    // True if the url is covered; path captures are added to the request on success
+    bool match(AsyncWebServerRequest *request) const;
+
+    RouteKind kind() const { return _kind; }
+    const String& uri() const { return _uri; }
+    const String& pattern() const { return _pattern; }
+
+    // Bumped whenever any route changes, so routers know to rebuild
+    static uint32_t revision() { return _revision; }
+};
+
+/*
+ * ROUTER :: Prefix tree of handler routes, keyed on path segments
+ *
+ * Lookup cost depends on the url rather than the number of routes.  Handlers without a
+ * route (or with one the tree can't index) are always offered, in registration order.
+ * */
+
+class AsyncWebRouter {
+  private:
+    struct Entry {
+      size_t order;
+      AsyncWebHandler* handler;
+    };
+    struct Tail {
+      String tail;        // rest of a prefix route, compared against the rest of the url
+      Entry entry;
+    };
+    struct Extension {
+      String extension;
+      Entry entry;
+    };
+    struct Node {
+      String segment;
+      std::vector<Node*> children;
+      Node* param;                    // {name} child
+      std::vector<Entry> handlers;    // path routes ending here
+      std::vector<Tail> prefixes;     // prefix routes branching off here
+      Node() : segment(), children(), param(nullptr) {}
+      ~Node();
+    };
+
+    Node _root;
+    std::vector<Extension> _extensions;
+    std::vector<Entry> _unrouted;
+    std::vector<Entry> _matches;              // scratch space, reused between lookups
+    std::vector<AsyncWebHandler*> _candidates;
+
+    static Node* _child(Node& node, const char* segment, size_t len, bool param);
+    void _collect(const Node& node, const char* rest);
+
+  public:
+    AsyncWebRouter() {}
+    ~AsyncWebRouter() { clear(); }
+    AsyncWebRouter(const AsyncWebRouter&) = delete;
+    AsyncWebRouter& operator=(const AsyncWebRouter&) = delete;
+
+    void clear();
+    void add(AsyncWebHandler* handler, size_t order);
+    // Handlers that may accept the url, in registration order.  Valid until the next call.
+    const std::vector<AsyncWebHandler*>& candidates(const char* url);
+};
+
+#endif /* ASYNCWEBSERVERROUTER_H_ */
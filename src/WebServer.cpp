@@ -27,6 +27,11 @@
 #define DEBUG_PRINTFP(...)
 #endif
 
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+#include <lwip/tcpip.h>
+#include <lwip/priv/tcp_priv.h>   // tcp_active_pcbs
+#endif
+
 #ifdef ASYNCWEBSERVER_NEEDS_MUTEX
 struct guard_type {
   SemaphoreHandle_t _mtx;
@@ -61,6 +66,37 @@ struct guard_type {
 #endif
 #endif
 
+// Idle timeout (seconds) and request limit for persistent connections
+#ifndef ASYNCWEBSERVER_KEEPALIVE_TIMEOUT
+#define ASYNCWEBSERVER_KEEPALIVE_TIMEOUT 2
+#endif
+
+#ifndef ASYNCWEBSERVER_KEEPALIVE_MAX
+#define ASYNCWEBSERVER_KEEPALIVE_MAX 32
+#endif
+
+// Request head limits; see AsyncWebServerHeadLimits
+#ifndef ASYNCWEBSERVER_REQUEST_LINE_MAX
+#define ASYNCWEBSERVER_REQUEST_LINE_MAX 2048
+#endif
+
+#ifndef ASYNCWEBSERVER_HEADER_LINE_MAX
+#define ASYNCWEBSERVER_HEADER_LINE_MAX 1024
+#endif
+
+#ifndef ASYNCWEBSERVER_HEADER_BYTES_MAX
+#define ASYNCWEBSERVER_HEADER_BYTES_MAX 8192
+#endif
+
+#ifndef ASYNCWEBSERVER_HEADER_COUNT_MAX
+#define ASYNCWEBSERVER_HEADER_COUNT_MAX 64
+#endif
+
+// Upload staging buffers kept for reuse once their request is done with them
+#ifndef ASYNCWEBSERVER_UPLOAD_POOL_MAX
+#define ASYNCWEBSERVER_UPLOAD_POOL_MAX 2
+#endif
+
 
 bool ON_STA_FILTER(AsyncWebServerRequest *request) {
   return WiFi.localIP() == request->client()->localIP();
@@ -71,19 +107,16 @@ bool ON_AP_FILTER(AsyncWebServerRequest *request) {
 }
 
 
-static bool minimal_send_503(AsyncClient* c) {
-    const static char msg[] PROGMEM = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\n";
-#ifdef PROGMEM  
-    char msg_stack[sizeof(msg)];  // stack, so we can pull it out of flash memory
-    memcpy_P(msg_stack, msg, sizeof(msg));
-    #define MSG_503 msg_stack
-#else
-    #define MSG_503 msg
-#endif
-    auto w = c->write(MSG_503, sizeof(MSG_503)-1, ASYNC_WRITE_FLAG_COPY);
+// Send 503 (server busy) or 429 (client over its limit) without allocating a request
+static bool minimal_send_error(AsyncClient* c, int code) {
+    const static char msg503[] PROGMEM = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    const static char msg429[] PROGMEM = "HTTP/1.1 429 Too Many Requests\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    char msg_stack[sizeof(msg503)];  // stack, so we can pull it out of flash memory; 503 is the longest
+    strcpy_P(msg_stack, (code == 429) ? msg429 : msg503);
+    auto w = c->write(msg_stack, strlen(msg_stack), ASYNC_WRITE_FLAG_COPY);
 
     // assume any nonzero value is success
-    DEBUG_PRINTFP("*** Sent 503 to %08X (%d), result %d\n", (intptr_t) c, c->getRemotePort(), w);
+    DEBUG_PRINTFP("*** Sent %d to %08X (%d), result %d\n", code, (intptr_t) c, c->getRemotePort(), w);
     if (w == 0) {    
       c->close(true); // sorry bud, we're really that strapped for ram  
     }
@@ -112,6 +145,59 @@ static inline size_t get_heap_alloc() {
 #endif
 
 
+// Starts each priority class gets per round while several have requests waiting
+#ifndef ASYNCWEBSERVER_PRIORITY_WEIGHT_HIGH
+#define ASYNCWEBSERVER_PRIORITY_WEIGHT_HIGH 4
+#endif
+#ifndef ASYNCWEBSERVER_PRIORITY_WEIGHT_NORMAL
+#define ASYNCWEBSERVER_PRIORITY_WEIGHT_NORMAL 2
+#endif
+#ifndef ASYNCWEBSERVER_PRIORITY_WEIGHT_LOW
+#define ASYNCWEBSERVER_PRIORITY_WEIGHT_LOW 1
+#endif
+
+// Waiting requests looked at when choosing between clients
+#ifndef ASYNCWEBSERVER_FAIR_SCAN
+#define ASYNCWEBSERVER_FAIR_SCAN 8
+#endif
+
+// Starts the earliest waiting request may be passed over for other clients before it goes next
+#ifndef ASYNCWEBSERVER_FAIR_MAX_SKIPS
+#define ASYNCWEBSERVER_FAIR_MAX_SKIPS 4
+#endif
+
+// Wait after which shortest-first scheduling stops letting smaller responses overtake, ms
+#ifndef ASYNCWEBSERVER_SHORTEST_FIRST_AGE_MS
+#define ASYNCWEBSERVER_SHORTEST_FIRST_AGE_MS 1000
+#endif
+
+// Longest Retry-After sent to requests that waited too long, seconds
+#ifndef ASYNCWEBSERVER_RETRY_AFTER_MAX
+#define ASYNCWEBSERVER_RETRY_AFTER_MAX 60
+#endif
+
+// Interval at which waiting requests are reconsidered when nothing else prompts it, ms
+#ifndef ASYNCWEBSERVER_QUEUE_BACKSTOP_MS
+#define ASYNCWEBSERVER_QUEUE_BACKSTOP_MS 100
+#endif
+
+static const uint8_t priority_weights[WRP_MAX] = {
+  ASYNCWEBSERVER_PRIORITY_WEIGHT_HIGH, ASYNCWEBSERVER_PRIORITY_WEIGHT_NORMAL, ASYNCWEBSERVER_PRIORITY_WEIGHT_LOW
+};
+
+size_t AsyncWebServer::_heapAvailable(){
+  return get_heap_available();
+}
+
+size_t AsyncWebServer::_heapLargestBlock(){
+  return get_heap_alloc();
+}
+
+// On ESP32 this runs on the timer task, where processQueue() wakes the network task to run the pass
+static void queue_backstop(AsyncWebServer* server){
+  server->processQueue();
+}
+
 AsyncWebServer::AsyncWebServer(uint16_t port)
   : AsyncWebServer(IPADDR_ANY, port)
 {
@@ -136,8 +222,40 @@ AsyncWebServer::AsyncWebServer(IPAddress addr, uint16_t port, const AsyncWebServ
 #ifdef ASYNCWEBSERVER_NEEDS_MUTEX
   , _mutex(xSemaphoreCreateMutex())
 #endif
-  , _requestQueue(LinkedList<AsyncWebServerRequest*>::OnRemove {})
+  , _idleRequests()
+  , _activeRequests()
+  , _queuedRequests()
+  , _deferredRequests()
+  , _priorityCredit()
+  , _clientSlots()
+  , _workers()
+  , _lastStart(0)
+  , _startInterval(0)
+  , _waitLongest(0)
+  , _shedCount(0)
+  , _scheduling(WRS_FIFO)
   , _queueActive(false)
+  , _queueRecheck(false)
+  , _queueDue(false)
+  , _stopping(false)
+  , _handling(nullptr)
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+  , _networkTask(nullptr)
+  , _wakePosted(false)
+  , _wakeClient(nullptr)
+  , _wakePcb(nullptr)
+#endif
+  , _queueTimer()
+  , _keepAliveTimeout(ASYNCWEBSERVER_KEEPALIVE_TIMEOUT)
+  , _keepAliveMax(ASYNCWEBSERVER_KEEPALIVE_MAX)
+  , _headLimits({ASYNCWEBSERVER_REQUEST_LINE_MAX, ASYNCWEBSERVER_HEADER_LINE_MAX, ASYNCWEBSERVER_HEADER_BYTES_MAX, ASYNCWEBSERVER_HEADER_COUNT_MAX})
+  , _router()
+  , _routerRevision(0)
+  , _routerStale(true)
+  , _interestingHeaders()
+  , _interestingHeadersVersion(0)
+  , _interestingHeadersStale(true)
+  , _uploadBuffers()
 {
   _catchAllHandler = new AsyncCallbackWebHandler();
   if(_catchAllHandler == NULL)
@@ -145,6 +263,10 @@ AsyncWebServer::AsyncWebServer(IPAddress addr, uint16_t port, const AsyncWebServ
   _server.onClient([this](void *s, AsyncClient* c){
     if(c == NULL)
       return;
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+    _networkTask = xTaskGetCurrentTaskHandle();
+#endif
+    _serviceQueue();
 
     auto heap_avail = get_heap_available();
     auto heap_alloc = get_heap_alloc();
@@ -155,20 +277,27 @@ AsyncWebServer::AsyncWebServer(IPAddress addr, uint16_t port, const AsyncWebServ
     if ((heap_avail < ASYNCWEBSERVER_MINIMUM_HEAP)
         || (heap_alloc && (heap_alloc < ASYNCWEBSERVER_MINIMUM_ALLOC))) {
       // Protect ourselves from crashing - just abandon this request.
-      DEBUG_PRINTFP("*** Dropping client %08X (%d): %d, %d/%d\n", (intptr_t) c, c->getRemotePort(), _requestQueue.length(), heap_alloc, heap_avail);
+      DEBUG_PRINTFP("*** Dropping client %08X (%d): %d/%d\n", (intptr_t) c, c->getRemotePort(), heap_alloc, heap_avail);
       c->close(true);
       delete c;
       return;
     }
 
     guard();
-    auto queue_length = _requestQueue.length();
-
+    auto queue_length = _clientCount();
+    auto slot = _findClientSlot(c->getRemoteAddress());
+    int refusal = 0;
     if (((_queueLimits.nMax > 0) && (queue_length >= _queueLimits.nMax))
         || ((_queueLimits.queueHeapRequired > 0) && (heap_avail < _queueLimits.queueHeapRequired))
     ) {
+      refusal = 503;
+    } else if ((_queueLimits.nPerClient > 0) && slot && (slot->connections >= _queueLimits.nPerClient)) {
+      refusal = 429;
+    }
+
+    if (refusal) {
       // Don't even allocate anything we can avoid.  Tell the client we're in trouble with a static response.
-      DEBUG_PRINTFP("*** Rejecting client %08X (%d): %d, %d/%d\n", (intptr_t) c, c->getRemotePort(), _requestQueue.length(), heap_alloc, heap_avail);
+      DEBUG_PRINTFP("*** Rejecting client %08X (%d): %d, %d, %d/%d\n", (intptr_t) c, c->getRemotePort(), refusal, queue_length, heap_alloc, heap_avail);
       c->setNoDelay(true);
       c->onDisconnect([](void*r, AsyncClient* rc){
         DEBUG_PRINTFP("*** Client %08X (%d) disconnected\n", (intptr_t)rc, rc->getRemotePort());
@@ -177,9 +306,9 @@ AsyncWebServer::AsyncWebServer(IPAddress addr, uint16_t port, const AsyncWebServ
       c->onAck([](void *, AsyncClient* rc, size_t s, uint32_t ){  
         if (s) rc->close(true);
       });
-      c->onData([](void*, AsyncClient* rc, void*, size_t){
+      c->onData([refusal](void*, AsyncClient* rc, void*, size_t){
         rc->onData({});
-        minimal_send_503(rc);
+        minimal_send_error(rc, refusal);
       });
       return;
     }
@@ -195,14 +324,43 @@ AsyncWebServer::AsyncWebServer(IPAddress addr, uint16_t port, const AsyncWebServ
     }
     
     
-    _requestQueue.add(r);
+    _idleRequests.push_back(r);
+    if (slot) {
+      ++slot->connections;
+    } else {
+      _clientSlots.push_back({ r->_remoteAddress, 1, 0 });
+    }
   }, this);
 }
 
 AsyncWebServer::~AsyncWebServer(){
+  _stopping = true;
+  _queueTimer.detach();
+  _workers.end();
+  // No pass will collect what the workers handed back; let those requests go now
+  auto job = _workers.takeDone();
+  while (job) {
+    auto next = job->next;
+    auto request = static_cast<AsyncWebServerRequest*>(job->arg);
+    request->_offloaded = false;
+    if (request->_orphaned) {
+      AsyncClient* client = request->_client;
+      delete request;
+      delete client;
+    } else {
+      request->_client->close(true);  // its disconnect deletes the request, then the client
+    }
+    job = next;
+  }
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+  while (_wakePosted) vTaskDelay(1);  // the tcpip thread still has a wake for us
+#endif
   reset();  
   end();
   if(_catchAllHandler) delete _catchAllHandler;
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+  vSemaphoreDelete(_mutex);
+#endif
 }
 
 AsyncWebRewrite& AsyncWebServer::addRewrite(AsyncWebRewrite* rewrite){
@@ -220,10 +378,14 @@ AsyncWebRewrite& AsyncWebServer::rewrite(const char* from, const char* to){
 
 AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler){
   _handlers.add(handler);
+  _routerStale = true;
+  _interestingHeadersStale = true;
   return *handler;
 }
 
 bool AsyncWebServer::removeHandler(AsyncWebHandler *handler){
+  _routerStale = true;
+  _interestingHeadersStale = true;
   return _handlers.remove(handler);
 }
 
@@ -246,8 +408,18 @@ void AsyncWebServer::beginSecure(const char *cert, const char *key, const char *
 }
 #endif
 
-void AsyncWebServer::_handleDisconnect(AsyncWebServerRequest *request){
+// False if the client has to be kept: the request is on a worker, which may still be using
+// both, and _collectOffloaded() deletes them together
+bool AsyncWebServer::_handleDisconnect(AsyncWebServerRequest *request){
+  {
+    guard();
+    if (request->_offloaded) {
+      request->_orphaned = true;
+      return false;
+    }
+  }
   delete request;
+  return true;
 }
 
 void AsyncWebServer::_rewriteRequest(AsyncWebServerRequest *request){
@@ -260,17 +432,67 @@ void AsyncWebServer::_rewriteRequest(AsyncWebServerRequest *request){
 }
 
 void AsyncWebServer::_attachHandler(AsyncWebServerRequest *request){
-  for(const auto& h: _handlers){
+  if(_routerStale || (_routerRevision != AsyncWebRoute::revision())){
+    // Routes changed since the tree was built
+    _router.clear();
+    size_t order = 0;
+    for(const auto& h: _handlers){
+      _router.add(h, order++);
+    }
+    _routerRevision = AsyncWebRoute::revision();
+    _routerStale = false;
+  }
+
+  for(const auto& h: _router.candidates(request->url().c_str())){
     if (h->filter(request) && h->canHandle(request)){
       request->setHandler(h);
       return;
     }
   }
   
-  request->addInterestingHeader("ANY");
   request->setHandler(_catchAllHandler);
 }
 
+const AsyncWebHeaderFilter& AsyncWebServer::_getInterestingHeaders(){
+  // Handlers may declare headers at any time, so recollect whenever any declaration was made
+  if(_interestingHeadersStale || (_interestingHeadersVersion != AsyncWebHandler::_headerDeclarations)){
+    _interestingHeaders.clear();
+    for(const auto& h: _handlers){
+      h->collectInterestingHeaders(_interestingHeaders);
+    }
+    if(_catchAllHandler && !_catchAllHandler->isRequestHandlerTrivial()){
+      _catchAllHandler->collectInterestingHeaders(_interestingHeaders);
+    }
+    _interestingHeadersVersion = AsyncWebHandler::_headerDeclarations;
+    _interestingHeadersStale = false;
+  }
+  return _interestingHeaders;
+}
+
+DynamicBuffer AsyncWebServer::_takeUploadBuffer(size_t size){
+  guard();
+  // Prefer the smallest idle buffer that fits
+  auto best = _uploadBuffers.end();
+  for(auto it = _uploadBuffers.begin(); it != _uploadBuffers.end(); ++it){
+    if((it->size() >= size) && ((best == _uploadBuffers.end()) || (it->size() < best->size()))) best = it;
+  }
+  if(best != _uploadBuffers.end()){
+    DynamicBuffer buffer = std::move(*best);
+    _uploadBuffers.erase(best);
+    return buffer;
+  }
+  return DynamicBuffer(size);
+}
+
+void AsyncWebServer::_returnUploadBuffer(DynamicBuffer&& buffer){
+  if(!buffer) return;
+  guard();
+  if(_uploadBuffers.size() < ASYNCWEBSERVER_UPLOAD_POOL_MAX){
+    _uploadBuffers.push_back(std::move(buffer));
+  } else {
+    buffer.clear();
+  }
+}
 
 AsyncCallbackWebHandler& AsyncWebServer::on(String uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody){
   AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler();
@@ -318,6 +540,7 @@ AsyncStaticWebHandler& AsyncWebServer::serveStatic(String uri, fs::FS& fs, Strin
 
 void AsyncWebServer::onNotFound(ArRequestHandlerFunction fn){
   _catchAllHandler->onRequest(fn);
+  _interestingHeadersStale = true;
 }
 
 void AsyncWebServer::onFileUpload(ArUploadHandlerFunction fn){
@@ -331,6 +554,8 @@ void AsyncWebServer::onRequestBody(ArBodyHandlerFunction fn){
 void AsyncWebServer::reset(){
   _rewrites.free();
   _handlers.free();
+  _routerStale = true;
+  _interestingHeadersStale = true;
   
   if (_catchAllHandler != NULL){
     _catchAllHandler->onRequest(NULL);
@@ -341,92 +566,470 @@ void AsyncWebServer::reset(){
 
 size_t AsyncWebServer::numClients(){
   guard();
-  return _requestQueue.length();
+  return _clientCount();
 }
 
 size_t AsyncWebServer::queueLength(){
   guard();
-  size_t count = 0U;
-  for(const auto& client: _requestQueue) { if (client->_parseState >= 200) ++count; };
+  return _queuedCount() + _deferredRequests.length();
+}
+
+// Callers hold the lock
+size_t AsyncWebServer::_clientCount() const {
+  return _idleRequests.length() + _deferredRequests.length() + _activeCount() + _queuedCount();
+}
+
+size_t AsyncWebServer::_queuedCount() const {
+  size_t count = 0;
+  for(const auto& list: _queuedRequests) count += list.length();
   return count;
 }
 
+size_t AsyncWebServer::_activeCount() const {
+  size_t count = 0;
+  for(const auto& list: _activeRequests) count += list.length();
+  return count;
+}
+
+// Class of the next request to start, or WRP_MAX if none may.  Weighted round robin: each class
+// has its weight in starts per round, so a busy class can't starve the others.  Callers hold the lock.
+uint8_t AsyncWebServer::_nextPriority(){
+  for (int round = 0; round < 2; ++round) {
+    for (uint8_t p = 0; p < WRP_MAX; ++p) {
+      if (_queuedRequests[p].isEmpty() || !_priorityCredit[p]) continue;
+      if (_queueLimits.nParallelClass[p] && (_activeRequests[p].length() >= _queueLimits.nParallelClass[p])) continue;
+      return p;
+    }
+    // Nothing waiting has starts left; begin the next round
+    for (uint8_t p = 0; p < WRP_MAX; ++p) _priorityCredit[p] = priority_weights[p];
+  }
+  return WRP_MAX;
+}
+
+// A request that has waited longer than queueWaitMax, if any.  Lists are in arrival order but for
+// requests that were started before (which never expire), so only the heads need looking at.
+// Callers hold the lock.
+AsyncWebServerRequest* AsyncWebServer::_expiredRequest(uint32_t now){
+  if (!_queueLimits.queueWaitMax) return nullptr;
+  for (const auto& list: _queuedRequests) {
+    for (auto entry = list.front(); entry; entry = AsyncWebRequestList::next(entry)) {
+      if (!entry->_queuedAt) continue;
+      if ((now - entry->_queuedAt) < _queueLimits.queueWaitMax) break;
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+// Seconds until the requests now waiting will have been started, at the recent rate.  Callers hold the lock.
+uint32_t AsyncWebServer::_retryAfter() const {
+  uint32_t interval = _startInterval ? _startInterval : 1000;
+  uint32_t seconds = (_queuedCount() * interval + 999) / 1000;
+  return std::min<uint32_t>(std::max<uint32_t>(seconds, 1), ASYNCWEBSERVER_RETRY_AFTER_MAX);
+}
+
+// Callers hold the lock
+AsyncWebServer::ClientSlot* AsyncWebServer::_findClientSlot(uint32_t address){
+  for (auto& slot: _clientSlots) {
+    if (slot.address == address) return &slot;
+  }
+  return nullptr;
+}
+
+// Of the first few requests waiting in a class, the one whose client has the fewest running, so
+// one client can't take every start; clients take turns as each start counts against them.
+// With WRS_SHORTEST_FIRST, ties go to the smallest expected response, until the oldest request
+// has waited ASYNCWEBSERVER_SHORTEST_FIRST_AGE_MS.  The earliest request goes next regardless
+// once it has been passed over ASYNCWEBSERVER_FAIR_MAX_SKIPS times.  Callers hold the lock.
+AsyncWebServerRequest* AsyncWebServer::_nextFair(const AsyncWebRequestList& list){
+  bool by_size = (_scheduling == WRS_SHORTEST_FIRST);
+  auto head = list.front();
+  if (head && (head->_fairSkips >= ASYNCWEBSERVER_FAIR_MAX_SKIPS)) return head;
+  if (by_size && head && (!head->_queuedAt || ((uint32_t) (millis() - head->_queuedAt) >= ASYNCWEBSERVER_SHORTEST_FIRST_AGE_MS))) {
+    by_size = false;  // started once already, or waited long enough; no more overtaking
+  }
+
+  AsyncWebServerRequest* best = nullptr;
+  size_t best_active = SIZE_MAX;
+  size_t best_size = SIZE_MAX;
+  size_t scanned = 0;
+  for (auto entry = head; entry && (scanned < ASYNCWEBSERVER_FAIR_SCAN); entry = AsyncWebRequestList::next(entry), ++scanned) {
+    auto slot = _findClientSlot(entry->_remoteAddress);
+    size_t active = slot ? slot->active : 0;
+    size_t size = by_size ? _expectedResponseSize(entry) : 0;
+    if ((active < best_active) || ((active == best_active) && (size < best_size))) {
+      best = entry;
+      best_active = active;
+      best_size = size;
+      if (!active && !by_size) break;   // can't do better
+    }
+  }
+  return best;
+}
+
+// Cached, as the handler may need the filesystem to answer.  Callers hold the lock.
+size_t AsyncWebServer::_expectedResponseSize(AsyncWebServerRequest *request){
+  if (!request->_expectedSize) {
+    size_t size = request->_handler ? request->_handler->expectedResponseSize(request) : 0;
+    request->_expectedSize = std::max<size_t>(size, 1);
+  }
+  return request->_expectedSize;
+}
+
+void AsyncWebServer::setScheduling(WebRequestScheduling scheduling) {
+  guard();
+  _scheduling = scheduling;
+}
+
+/*
+ * REQUEST LIST
+ * */
+
+void AsyncWebRequestList::push_back(AsyncWebServerRequest* request){
+  request->_queueList = this;
+  request->_queuePrev = _tail;
+  request->_queueNext = nullptr;
+  if(_tail) _tail->_queueNext = request; else _head = request;
+  _tail = request;
+  ++_length;
+}
+
+void AsyncWebRequestList::push_front(AsyncWebServerRequest* request){
+  request->_queueList = this;
+  request->_queuePrev = nullptr;
+  request->_queueNext = _head;
+  if(_head) _head->_queuePrev = request; else _tail = request;
+  _head = request;
+  ++_length;
+}
+
+void AsyncWebRequestList::remove(AsyncWebServerRequest* request){
+  if(request->_queuePrev) request->_queuePrev->_queueNext = request->_queueNext; else _head = request->_queueNext;
+  if(request->_queueNext) request->_queueNext->_queuePrev = request->_queuePrev; else _tail = request->_queuePrev;
+  request->_queuePrev = request->_queueNext = nullptr;
+  request->_queueList = nullptr;
+  --_length;
+}
+
 void AsyncWebServer::processQueue(){  
   // Consider the state of the requests in the queue.
   // Requests in STATE_END have already been handled; we can assume any heap they need has already been allocated.
   // Requests in STATE_QUEUED are pending.  Each iteration we consider the first one.
   // We always allow one request, regardless of heap state.
-#ifdef ASYNCWEBSERVER_DEBUG_TRACE
-  size_t count = 0, active = 0, queued = 0;
+  if (_stopping) return;  // the destructor deals with what is left
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+  if (xTaskGetCurrentTaskHandle() != _networkTask) {
+    // Timer, worker or sketch task: handlers and clients are only touched from the network task,
+    // so have the pass run there
+    _queueDue = true;
+    _wakeNetworkTask();
+    return;
+  }
 #endif
-
+  _queueDue = false;
   {
     guard();
-    if (_queueActive) return; // already in progress
+    if (_queueActive) {
+      // Already in progress; make sure it sees whatever changed
+      _queueRecheck = true;
+      return;
+    }
     _queueActive = true;
 
-#ifdef ASYNCWEBSERVER_DEBUG_TRACE
-    for(auto element: _requestQueue) {
-      ++count;
-      if (element->_parseState == 100) ++active;
-      if (element->_parseState == 200) ++queued;
-    }
-#endif    
+    DEBUG_PRINTFP("Queue: %d clients, %d running, %d deferred\n", _clientCount(), _activeCount(), _deferredRequests.length());
   }
 
-  DEBUG_PRINTFP("Queue: %d entries, %d running, %d queued\n", count, active, queued);
+  bool again;
+  do {
+    _collectOffloaded();
+
+    // Shed requests that won't be served in time, so their memory goes to ones that can be
+    do {
+      AsyncWebServerRequest* expired;
+      uint32_t retry_after;
+      {
+        guard();
+        expired = _expiredRequest(millis());
+        if (!expired) break;
+        retry_after = _retryAfter();
+        ++_shedCount;
+      }
+      DEBUG_PRINTFP("Shedding %08X, retry after %d\n", (intptr_t) expired, retry_after);
+      expired->_rejectHead(503, retry_after);
+    } while(1);
+
+    do { 
+      size_t active_entries = 0;
+      AsyncWebServerRequest* next_queued_request = nullptr;
+      uint8_t priority;
+
+      {
+        // Get a queued entry while holding the lock
+        guard();
+        active_entries = _activeCount();
+        priority = _nextPriority();
+        if (priority < WRP_MAX) next_queued_request = _nextFair(_queuedRequests[priority]);
+      }
 
-  do { 
-    auto heap_ok = get_heap_available() > _queueLimits.requestHeapRequired;
-    auto alloc_ok = get_heap_alloc() > ASYNCWEBSERVER_MINIMUM_ALLOC;
-    size_t active_entries = 0;
-    AsyncWebServerRequest* next_queued_request = nullptr;
+      if (!next_queued_request) break;  // all done
+      if ((_queueLimits.nParallel > 0) && (active_entries >= _queueLimits.nParallel)) break; // lots running
+      auto heap_required = _queueLimits.requestHeapRequired;
+      if (next_queued_request->_handler) heap_required += next_queued_request->_handler->requestHeapCost(next_queued_request);
+      auto heap_ok = get_heap_available() > heap_required;
+      size_t alloc_required = ASYNCWEBSERVER_MINIMUM_ALLOC;
+      if (next_queued_request->_handler) alloc_required = std::max(alloc_required, next_queued_request->_handler->learnedBlockCost());
+      auto alloc_ok = get_heap_alloc() > alloc_required;
+      if ((active_entries > 0) && (!heap_ok || !alloc_ok)) {
+        DEBUG_PRINTFP("Can't queue more, heap %d alloc %d\n", heap_ok, alloc_ok);
+        break;
+      }    
+      {
+        // Measure how fast the queue drains while requests are waiting
+        guard();
+        uint32_t now = millis();
+        if (next_queued_request->_queuedAt) _waitLongest = std::max<uint32_t>(_waitLongest, now - next_queued_request->_queuedAt);
+        if (_lastStart) {
+          uint32_t sample = now - _lastStart;
+          _startInterval = _startInterval ? (_startInterval - _startInterval / 4 + sample / 4) : sample;
+        }
+        _lastStart = (_queuedCount() > 1) ? (now | 1) : 0;
+        if (_priorityCredit[priority]) --_priorityCredit[priority];
+        auto head = _queuedRequests[priority].front();
+        if (head && (head != next_queued_request)) ++head->_fairSkips;
+      }
+      if (next_queued_request->_parseState == 202) {
+        next_queued_request->_sendContinue();   // its body is next; it runs once that is in
+      } else {
+        // The handler may delete the request; _dequeue() clears _handling if it does
+        _handling = next_queued_request;
+        next_queued_request->_handleRequest();
+        if (_handling && !_handling->_offloaded) _handling->_sampleHeap();   // what the handler kept hold of counts too
+        _handling = nullptr;
+      }
+    } while(1); // as long as we have memory and queued requests
 
     {
-      // Get a queued entry while holding the lock
       guard();
-      for(auto entry: _requestQueue) {
-        if (entry->_parseState == 100) {
-          ++active_entries;
-        } else if ((entry->_parseState == 200) && !next_queued_request) {
-          next_queued_request = entry;
-        };
+      again = _queueRecheck;
+      _queueRecheck = false;
+      if (!again) {
+        auto entry = _deferredRequests.front();
+        while (entry) {
+          // Un-defer requests; those that deferred from a worker wait until it has let them go
+          auto next = AsyncWebRequestList::next(entry);
+          if (!entry->_offloaded) {
+            _deferredRequests.remove(entry);
+            entry->_parseState = 200;
+            _queuedRequests[entry->_handler ? entry->_handler->priority() : WRP_NORMAL].push_back(entry);
+          }
+          entry = next;
+        }
+        _queueActive = false;
+
+        // Requests are started as things finish or free memory; the timer covers heap freed elsewhere,
+        // deferred handlers and wait limits, without waiting for the connection poll.
+        if (_queuedCount()) {
+          _queueTimer.once_ms(ASYNCWEBSERVER_QUEUE_BACKSTOP_MS, queue_backstop, this);
+        } else {
+          _queueTimer.detach();
+        }
+      }
+    }
+  } while(again);
+}
+
+#ifdef ASYNCWEBSERVER_NEEDS_MUTEX
+// Get an event to the network task soon, so a pass marked as due isn't left for the next poll.
+// There is no way to post to the AsyncTCP task directly, so one of our connections is polled
+// from the tcpip thread; AsyncTCP queues that like any other poll, and _onPoll() runs the pass.
+void AsyncWebServer::_wakeNetworkTask(){
+  if (_wakePosted.exchange(true)) return;   // one is on its way
+  AsyncClient* client = nullptr;
+  tcp_pcb* pcb = nullptr;
+  {
+    guard();
+    AsyncWebRequestList* lists[] = { &_activeRequests[WRP_HIGH], &_activeRequests[WRP_NORMAL], &_activeRequests[WRP_LOW],
+      &_queuedRequests[WRP_HIGH], &_queuedRequests[WRP_NORMAL], &_queuedRequests[WRP_LOW], &_deferredRequests, &_idleRequests };
+    for (auto list: lists) {
+      for (auto entry = list->front(); entry && !pcb; entry = AsyncWebRequestList::next(entry)) {
+        if (entry->_orphaned || !entry->_client) continue;
+        client = entry->_client;
+        pcb = client->pcb();
       }
+      if (pcb) break;
     }
+  }
+  if (!pcb) {
+    // No connection to carry it; the next one to arrive runs the pass
+    _wakePosted = false;
+    return;
+  }
+  // Read on the tcpip thread, which never takes our lock; it only clears _wakePosted after
+  _wakeClient = client;
+  _wakePcb = pcb;
+  if (tcpip_try_callback(_wakeOnTcpip, this) != ERR_OK) _wakePosted = false;
+}
 
-    if (!next_queued_request) break;  // all done
-    if ((_queueLimits.nParallel > 0) && (active_entries >= _queueLimits.nParallel)) break; // lots running
-    if ((active_entries > 0) && (!heap_ok || !alloc_ok)) {
-      DEBUG_PRINTFP("Can't queue more, heap %d alloc %d\n", heap_ok, alloc_ok);
+// On the tcpip thread.  The connection may have closed since it was chosen, so it is only polled
+// if its pcb is still active and still belongs to the same client.
+void AsyncWebServer::_wakeOnTcpip(void* arg){
+  auto server = static_cast<AsyncWebServer*>(arg);
+  for (tcp_pcb* pcb = tcp_active_pcbs; pcb; pcb = pcb->next) {
+    if (pcb == server->_wakePcb) {
+      if ((pcb->callback_arg == server->_wakeClient) && pcb->poll) pcb->poll(pcb->callback_arg, pcb);
       break;
-    }    
-    next_queued_request->_handleRequest();
-  } while(1); // as long as we have memory and queued requests
+    }
+  }
+  server->_wakePosted = false;
+}
+#endif
+
+// On the worker: the pass that collects the job is run from the network task
+static void offload_finished(void* server){
+  static_cast<AsyncWebServer*>(server)->processQueue();
+}
 
+// Hand a started request to a worker; false to run it here instead
+bool AsyncWebServer::_offload(AsyncWebServerRequest *request){
+  if (!_workers.running() && !_workers.begin(ASYNCWEBSERVER_WORKERS, offload_finished, this)) return false;
   {
     guard();
-    for(auto entry: _requestQueue) {
-      // Un-defer requests
-      if (entry->_parseState == 201) entry->_parseState = 200;
+    request->_offloaded = true;
+  }
+  request->_offloadJob = { nullptr, AsyncWebServerRequest::_runOffloaded, request, false };
+  if (_workers.submit(&request->_offloadJob)) return true;
+  guard();
+  request->_offloaded = false;
+  return false;
+}
+
+// Finish the requests whose handlers have returned on a worker, or that end() handed back
+void AsyncWebServer::_collectOffloaded(){
+  auto job = _workers.takeDone();
+  while (job) {
+    auto next = job->next;
+    auto request = static_cast<AsyncWebServerRequest*>(job->arg);
+    bool orphaned;
+    {
+      guard();
+      request->_offloaded = false;
+      orphaned = request->_orphaned;
+    }
+    if (orphaned) {
+      AsyncClient* client = request->_client;
+      delete request;
+      delete client;
+    } else {
+      request->_finishOffload(job->cancelled);
     }
-    _queueActive = false;
+    job = next;
   }
 }
 
+void AsyncWebServer::notifyResourcesFreed(){
+  processQueue();
+}
+
 void AsyncWebServer::_dequeue(AsyncWebServerRequest *request){
   {
     DEBUG_PRINTFP("Removing %08X from queue\n", (intptr_t) request);
     guard();    
-    _requestQueue.remove(request);
+    if (_handling == request) _handling = nullptr;
+    auto slot = _findClientSlot(request->_remoteAddress);
+    if (request->_queueList) {
+      if (slot && _isActiveList(request->_queueList)) --slot->active;
+      request->_queueList->remove(request);
+    }
+    if (slot && !--slot->connections) {
+      // Last connection from this address
+      *slot = _clientSlots.back();
+      _clientSlots.pop_back();
+    }
   }
   processQueue();
 }
 
+// Move a request to the list for its new parse state
+void AsyncWebServer::_updateQueue(AsyncWebServerRequest *request){
+  const uint8_t priority = request->_handler ? request->_handler->priority() : WRP_NORMAL;
+  AsyncWebRequestList* list;
+  switch (request->_parseState) {
+    case 100: list = &_activeRequests[priority]; break;
+    case 2: list = request->_expectingContinue ? &_activeRequests[priority] : &_idleRequests; break;   // invited body
+    case 200:
+    case 202: list = &_queuedRequests[priority]; break;
+    case 201: list = &_deferredRequests; break;
+    default: list = &_idleRequests; break;
+  }
+
+  guard();
+  auto from = request->_queueList;
+  if (!from || (from == list)) return;  // already gone, or no move
+  if (_isActiveList(from) != _isActiveList(list)) {
+    auto slot = _findClientSlot(request->_remoteAddress);
+    if (slot) {
+      if (_isActiveList(list)) ++slot->active; else --slot->active;
+    }
+  }
+  from->remove(request);
+  if (!_isQueuedList(list)) {
+    request->_queuedAt = 0;
+    request->_expectedSize = 0;
+    request->_fairSkips = 0;
+  } else if (from == &_idleRequests) {
+    request->_queuedAt = millis() | 1;  // new arrival; starts its wait
+  }
+  if ((from == &_activeRequests[priority]) && (list == &_queuedRequests[priority])) {
+    list->push_front(request);  // admitted already, to send its body; don't send it to the back
+  } else {
+    list->push_back(request);
+  }
+}
+
+// Whether a request waiting to send its body should be told to go ahead: 100 if it can be handled
+// now, 0 to withhold the continue until processQueue() gets to it, or the status to refuse it with.
+int AsyncWebServer::_continueStatus(AsyncWebServerRequest *request){
+  const uint8_t priority = request->_handler ? request->_handler->priority() : WRP_NORMAL;
+  size_t active_entries = 0;
+  bool waiting = false;
+  bool class_full = false;
+  {
+    guard();
+    active_entries = _activeCount();  // running, or sending a body we asked for
+    for (uint8_t p = 0; p <= priority; ++p) waiting |= !_queuedRequests[p].isEmpty();
+    class_full = _queueLimits.nParallelClass[priority] && (_activeRequests[priority].length() >= _queueLimits.nParallelClass[priority]);
+  }
+
+  auto heap_avail = get_heap_available();
+  if ((_queueLimits.queueHeapRequired > 0) && (heap_avail < _queueLimits.queueHeapRequired)) return 503;
+  auto heap_required = _queueLimits.requestHeapRequired;
+  if (request->_handler) heap_required += request->_handler->requestHeapCost(request);
+  if (heap_avail <= heap_required) {
+    // Nothing running to give memory back, so waiting won't help
+    return active_entries ? 0 : 417;
+  }
+  if (waiting) return 0;  // don't overtake requests already queued in our class or above
+  if ((_queueLimits.nParallel > 0) && (active_entries >= _queueLimits.nParallel)) return 0;
+  if (class_full) return 0;
+  return 100;
+}
+
 void AsyncWebServer::setQueueLimits(const AsyncWebServerQueueLimits& limits) {
   guard();
   _queueLimits = limits;
 }
 
+void AsyncWebServer::setKeepAlive(uint32_t timeout, size_t maxRequests) {
+  guard();
+  _keepAliveTimeout = timeout;
+  _keepAliveMax = maxRequests;
+}
+
+void AsyncWebServer::setHeadLimits(const AsyncWebServerHeadLimits& limits) {
+  guard();
+  _headLimits = limits;
+}
+
 void AsyncWebServer::printStatus(Print& dest){
   dest.print(F("Web server status: "));
 #ifdef ASYNCWEBSERVER_NEEDS_MUTEX
@@ -442,16 +1045,28 @@ void AsyncWebServer::printStatus(Print& dest){
 #endif  
   {
     guard();
-    if (_requestQueue.isEmpty()) {
+    if (_clientCount() == 0) {
       print_dest.print(F(" Idle\n"));
     } else {
-      for(const auto& entry: _requestQueue) {
-        print_dest.printf_P(PSTR("\n- Request %X [%X], state %d"), (intptr_t) entry, (intptr_t) entry->_client, entry->_parseState);
-        if (entry->_response) {
-          auto r = entry->_response;
-          print_dest.printf_P(PSTR(" -- Response %X, state %d, [%d %d - %d %d %d]"), (intptr_t) r, r->_state, r->_headLength, r->_contentLength, r->_sentLength, r->_ackedLength, r->_writtenLength);
+      const AsyncWebRequestList* lists[] = {
+        &_activeRequests[WRP_HIGH], &_activeRequests[WRP_NORMAL], &_activeRequests[WRP_LOW],
+        &_queuedRequests[WRP_HIGH], &_queuedRequests[WRP_NORMAL], &_queuedRequests[WRP_LOW],
+        &_deferredRequests, &_idleRequests
+      };
+      for (auto list : lists) {
+        for (auto entry = list->front(); entry; entry = AsyncWebRequestList::next(entry)) {
+          print_dest.printf_P(PSTR("\n- Request %X [%X], state %d"), (intptr_t) entry, (intptr_t) entry->_client, entry->_parseState);
+          if (entry->_queuedAt) print_dest.printf_P(PSTR(", waiting %u ms"), (unsigned) (millis() - entry->_queuedAt));
+          if (entry->_response) {
+            auto r = entry->_response;
+            print_dest.printf_P(PSTR(" -- Response %X, state %d, [%d %d - %d %d %d]"), (intptr_t) r, r->_state, r->_headLength, r->_contentLength, r->_sentLength, r->_ackedLength, r->_writtenLength);
+          }
         }
       }
+      print_dest.printf_P(PSTR("\n- Queue: %u ms between starts, longest wait %u ms, %u shed"), (unsigned) _startInterval, (unsigned) _waitLongest, (unsigned) _shedCount);
+      for (const auto& slot: _clientSlots) {
+        print_dest.printf_P(PSTR("\n- Client %s: %d connections, %d running"), IPAddress(slot.address).toString().c_str(), slot.connections, slot.active);
+      }
       print_dest.write('\n');
     }
   }
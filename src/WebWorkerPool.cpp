@@ -0,0 +1,232 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "WebWorkerPool.h"
+
+#ifndef ASYNCWEBSERVER_WORKER_STACK
+#define ASYNCWEBSERVER_WORKER_STACK 8192
+#endif
+
+#ifndef ASYNCWEBSERVER_WORKER_PRIORITY
+#define ASYNCWEBSERVER_WORKER_PRIORITY 2  // below the async_tcp task, above loop()
+#endif
+
+#ifndef ASYNCWEBSERVER_WORKER_QUEUE
+#define ASYNCWEBSERVER_WORKER_QUEUE 8
+#endif
+
+AsyncWebWorkerPool::AsyncWebWorkerPool()
+  : _done(nullptr)
+  , _pending(0)
+  , _workers(0)
+  , _notify(nullptr)
+  , _notifyArg(nullptr)
+#if defined(ASYNCWEBSERVER_WORKERS_STD_THREAD)
+  , _threads()
+  , _mutex()
+  , _ready()
+  , _jobs()
+  , _stopping(false)
+#elif defined(ASYNCWEBSERVER_WORKERS_FREERTOS)
+  , _jobs(nullptr)
+  , _stopped(nullptr)
+#endif
+{
+}
+
+// Worker side: push on the finished stack
+void AsyncWebWorkerPool::_finish(AsyncWebWorkerJob* job){
+  AsyncWebWorkerJob* head = _done.load(std::memory_order_relaxed);
+  do {
+    job->next = head;
+  } while(!_done.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+  if(_notify) _notify(_notifyArg);
+}
+
+AsyncWebWorkerJob* AsyncWebWorkerPool::takeDone(){
+  AsyncWebWorkerJob* stack = _done.exchange(nullptr, std::memory_order_acquire);
+  // Newest first on the stack; reverse so jobs come back in the order they finished
+  AsyncWebWorkerJob* list = nullptr;
+  size_t count = 0;
+  while(stack){
+    AsyncWebWorkerJob* next = stack->next;
+    stack->next = list;
+    list = stack;
+    stack = next;
+    ++count;
+  }
+  if(count) _pending.fetch_sub(count, std::memory_order_relaxed);
+  return list;
+}
+
+#if defined(ASYNCWEBSERVER_WORKERS_STD_THREAD)
+
+bool AsyncWebWorkerPool::begin(size_t workers, void (*notify)(void* arg), void* arg){
+  if(_workers || !workers) return _workers != 0;
+  _notify = notify;
+  _notifyArg = arg;
+  _stopping = false;
+  for(size_t i = 0; i < workers; ++i){
+    _threads.emplace_back([this]{ _work(); });
+  }
+  _workers = workers;
+  return true;
+}
+
+void AsyncWebWorkerPool::end(){
+  if(!_workers) return;
+  std::deque<AsyncWebWorkerJob*> unstarted;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+    unstarted.swap(_jobs);
+  }
+  _ready.notify_all();
+  for(auto& thread: _threads) thread.join();
+  for(auto job: unstarted){
+    job->cancelled = true;
+    _finish(job);
+  }
+  _threads.clear();
+  _workers = 0;
+}
+
+bool AsyncWebWorkerPool::submit(AsyncWebWorkerJob* job){
+  if(!_workers || !job) return false;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_jobs.size() >= ASYNCWEBSERVER_WORKER_QUEUE) return false;
+    _pending.fetch_add(1, std::memory_order_relaxed);   // before a worker can finish it
+    job->cancelled = false;
+    _jobs.push_back(job);
+  }
+  _ready.notify_one();
+  return true;
+}
+
+void AsyncWebWorkerPool::_work(){
+  for(;;){
+    AsyncWebWorkerJob* job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _ready.wait(lock, [this]{ return _stopping || !_jobs.empty(); });
+      if(_stopping) return;
+      job = _jobs.front();
+      _jobs.pop_front();
+    }
+    job->run(job->arg);
+    _finish(job);
+  }
+}
+
+#elif defined(ASYNCWEBSERVER_WORKERS_FREERTOS)
+
+bool AsyncWebWorkerPool::begin(size_t workers, void (*notify)(void* arg), void* arg){
+  if(_workers || !workers) return _workers != 0;
+  _notify = notify;
+  _notifyArg = arg;
+  _jobs = xQueueCreate(ASYNCWEBSERVER_WORKER_QUEUE, sizeof(AsyncWebWorkerJob*));
+  _stopped = xSemaphoreCreateCounting(workers, 0);
+  if(!_jobs || !_stopped){
+    if(_jobs) vQueueDelete(_jobs);
+    if(_stopped) vSemaphoreDelete(_stopped);
+    _jobs = nullptr;
+    _stopped = nullptr;
+    return false;
+  }
+  for(size_t i = 0; i < workers; ++i){
+    if(xTaskCreate(_task, "aws_worker", ASYNCWEBSERVER_WORKER_STACK, this, ASYNCWEBSERVER_WORKER_PRIORITY, nullptr) != pdPASS) break;
+    ++_workers;
+  }
+  if(!_workers){
+    vQueueDelete(_jobs);
+    vSemaphoreDelete(_stopped);
+    _jobs = nullptr;
+    _stopped = nullptr;
+  }
+  return _workers != 0;
+}
+
+void AsyncWebWorkerPool::end(){
+  if(!_workers) return;
+  AsyncWebWorkerJob* job;
+  while(xQueueReceive(_jobs, &job, 0) == pdTRUE){
+    job->cancelled = true;
+    _finish(job);
+  }
+  AsyncWebWorkerJob* stop = nullptr;
+  for(size_t i = 0; i < _workers; ++i) xQueueSend(_jobs, &stop, portMAX_DELAY);
+  for(size_t i = 0; i < _workers; ++i) xSemaphoreTake(_stopped, portMAX_DELAY);
+  vQueueDelete(_jobs);
+  vSemaphoreDelete(_stopped);
+  _jobs = nullptr;
+  _stopped = nullptr;
+  _workers = 0;
+}
+
+bool AsyncWebWorkerPool::submit(AsyncWebWorkerJob* job){
+  if(!_workers || !job) return false;
+  _pending.fetch_add(1, std::memory_order_relaxed);
+  job->cancelled = false;
+  if(xQueueSend(_jobs, &job, 0) != pdTRUE){
+    _pending.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void AsyncWebWorkerPool::_task(void* pool){
+  static_cast<AsyncWebWorkerPool*>(pool)->_work();
+  vTaskDelete(NULL);
+}
+
+void AsyncWebWorkerPool::_work(){
+  for(;;){
+    AsyncWebWorkerJob* job = nullptr;
+    if(xQueueReceive(_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+    if(!job) break;   // end()
+    job->run(job->arg);
+    _finish(job);
+  }
+  xSemaphoreGive(_stopped);
+}
+
+#else
+
+// No tasks to run jobs on; the owner runs them itself
+bool AsyncWebWorkerPool::begin(size_t workers, void (*notify)(void* arg), void* arg){
+  (void) workers;
+  (void) notify;
+  (void) arg;
+  return false;
+}
+
+void AsyncWebWorkerPool::end(){
+}
+
+bool AsyncWebWorkerPool::submit(AsyncWebWorkerJob* job){
+  (void) job;
+  return false;
+}
+
+void AsyncWebWorkerPool::_work(){
+}
+
+#endif
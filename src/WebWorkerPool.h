@@ -0,0 +1,102 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBWORKERPOOL_H_
+#define ASYNCWEBWORKERPOOL_H_
+
+// Included from ESPAsyncWebServer.h; depends on nothing else in the library, so it can be built
+// and exercised on a host with ASYNCWEBSERVER_WORKERS_STD_THREAD.
+
+#include <stddef.h>
+#include <atomic>
+
+#if defined(ASYNCWEBSERVER_WORKERS_STD_THREAD)
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#elif defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#define ASYNCWEBSERVER_WORKERS_FREERTOS
+#endif
+
+#ifndef ASYNCWEBSERVER_WORKERS
+#define ASYNCWEBSERVER_WORKERS 1        // worker tasks, started when first needed
+#endif
+
+/*
+ * WORKER POOL :: Runs jobs off the network task and hands them back without locking
+ *
+ * Jobs go to the workers through a queue; finished ones are pushed on a lock-free stack that
+ * the owner takes in one exchange, from whichever task it likes.  Where the platform has no
+ * tasks (ESP8266), begin() fails and the owner runs the job itself.
+ * */
+
+struct AsyncWebWorkerJob {
+  AsyncWebWorkerJob* next;      // link on the finished stack, and in the list takeDone() returns
+  void (*run)(void* arg);
+  void* arg;
+  bool cancelled;               // handed back by end() without being run
+};
+
+class AsyncWebWorkerPool {
+  private:
+    std::atomic<AsyncWebWorkerJob*> _done;
+    std::atomic<size_t> _pending;   // submitted and not yet taken back
+    size_t _workers;
+    void (*_notify)(void* arg);     // called on the worker after each job is finished
+    void* _notifyArg;
+#if defined(ASYNCWEBSERVER_WORKERS_STD_THREAD)
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::deque<AsyncWebWorkerJob*> _jobs;
+    bool _stopping;
+#elif defined(ASYNCWEBSERVER_WORKERS_FREERTOS)
+    QueueHandle_t _jobs;
+    SemaphoreHandle_t _stopped;     // given by each worker as it exits
+    static void _task(void* pool);
+#endif
+    void _finish(AsyncWebWorkerJob* job);
+    void _work();
+
+  public:
+    AsyncWebWorkerPool();
+    ~AsyncWebWorkerPool() { end(); }
+    AsyncWebWorkerPool(const AsyncWebWorkerPool&) = delete;
+    AsyncWebWorkerPool& operator=(const AsyncWebWorkerPool&) = delete;
+
+    // False if workers aren't available here.  notify is called from the worker once a job can be
+    // taken back, so the owner can arrange to collect it on its own task.
+    bool begin(size_t workers, void (*notify)(void* arg) = nullptr, void* arg = nullptr);
+    void end();                     // waits for the workers; jobs not yet started come back cancelled
+    bool running() const { return _workers != 0; }
+
+    bool submit(AsyncWebWorkerJob* job);  // false if it can't be taken now; never blocks
+    // Finished jobs, oldest first, linked through next
+    AsyncWebWorkerJob* takeDone();
+    size_t pending() const { return _pending.load(std::memory_order_relaxed); }
+};
+
+#endif /* ASYNCWEBWORKERPOOL_H_ */
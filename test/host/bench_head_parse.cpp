@@ -0,0 +1,58 @@
+// Allocations and time spent turning a request head into a dispatched request.  Counted from
+// the first byte received to the handler being called, so request construction is included but
+// the response is not.  Run against another tree with: make bench SRC=/path/to/src
+#include "host.h"
+
+static AsyncWebServer server(80);
+
+static const std::string head =
+  "GET /api/state?v=1 HTTP/1.1\r\n"
+  "Host: 192.168.4.1\r\n"
+  "Connection: keep-alive\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+  "Accept: application/json, text/plain, */*\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Accept-Language: en-US,en;q=0.9\r\n"
+  "Referer: http://192.168.4.1/settings\r\n"
+  "Cookie: session=0123456789abcdef; theme=dark\r\n"
+  "Cache-Control: no-cache\r\n"
+  "\r\n";
+
+static size_t allocationsAtHandler;
+static std::chrono::steady_clock::time_point timeAtHandler;
+
+static void bench(const char* name, size_t piece, int iterations) {
+  size_t allocations = 0;
+  std::chrono::nanoseconds elapsed(0);
+  for (int i = 0; i < iterations; ++i) {
+    host::Connection c;
+    size_t before = host::allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t at = 0; at < head.size(); at += piece) {
+      c.receive(head.data() + at, std::min(piece, head.size() - at));
+    }
+    allocations += allocationsAtHandler - before;
+    elapsed += timeAtHandler - start;
+    c.ack();
+  }
+  printf("  %-24s %6.1f allocations  %8.0f ns\n", name, (double) allocations / iterations, (double) elapsed.count() / iterations);
+}
+
+int main() {
+  server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest* request){
+    allocationsAtHandler = host::allocations.load();
+    timeAtHandler = std::chrono::steady_clock::now();
+    request->send(204);
+  });
+  server.begin();
+
+  const int iterations = 20000;
+  printf("bench_head_parse: %zu byte head, per request\n", head.size());
+  bench("one packet", head.size(), iterations);
+  bench("536 byte segments", 536, iterations);
+  bench("64 byte segments", 64, iterations);
+  bench("byte at a time", 1, iterations / 10);
+
+  server.end();
+  return 0;
+}
@@ -0,0 +1,50 @@
+// Allocations and time spent routing requests through the regex_patterns example routes.  Counted
+// from the first byte received to the handler being called, like bench_head_parse, so the
+// difference between the two is mostly the regex match.  Run against another tree with:
+// make bench SRC=/path/to/src
+#include "host.h"
+
+static AsyncWebServer server(80);
+
+static size_t allocationsAtHandler;
+static std::chrono::steady_clock::time_point timeAtHandler;
+static String firstArg;
+
+static void record(AsyncWebServerRequest* request) {
+  allocationsAtHandler = host::allocations.load();
+  timeAtHandler = std::chrono::steady_clock::now();
+  firstArg = request->pathArg(0);
+  request->send(204);
+}
+
+static void bench(const char* name, const std::string& head, int iterations) {
+  size_t allocations = 0;
+  std::chrono::nanoseconds elapsed(0);
+  for (int i = 0; i < iterations; ++i) {
+    host::Connection c;
+    firstArg = String();
+    size_t before = host::allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    c.receive(head);
+    CHECK(firstArg == "42");
+    allocations += allocationsAtHandler - before;
+    elapsed += timeAtHandler - start;
+    c.ack();
+  }
+  printf("  %-24s %6.1f allocations  %8.0f ns\n", name, (double) allocations / iterations, (double) elapsed.count() / iterations);
+}
+
+int main() {
+  server.on("/", HTTP_GET, [](AsyncWebServerRequest* request){ request->send(204); });
+  server.on("^\\/sensor\\/([0-9]+)$", HTTP_GET, record);
+  server.on("^\\/sensor\\/([0-9]+)\\/action\\/([a-zA-Z0-9]+)$", HTTP_GET, record);
+  server.begin();
+
+  const int iterations = 20000;
+  printf("bench_regex_routes: per request\n");
+  bench("/sensor/42", "GET /sensor/42 HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n", iterations);
+  bench("/sensor/42/action/on", "GET /sensor/42/action/on HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n", iterations);
+
+  server.end();
+  return 0;
+}
@@ -0,0 +1,761 @@
+// Host implementations of the stubbed platform: Arduino core bits, FreeRTOS on std threads,
+// a Ticker on one timer thread, lwIP's tcpip thread, and an AsyncTCP that tests drive through
+// host::Connection.
+#include "host.h"
+
+#include <FS.h>
+#include <Ticker.h>
+#include <WiFi.h>
+#include <libb64/cencode.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/tcpip.h>
+#include <mbedtls/md5.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+/*
+ * Time, heap and the Arduino core
+ * */
+
+static const clock_type::time_point boot = clock_type::now();
+static std::atomic<unsigned long> skipped(0);
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - boot).count() + skipped;
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - boot).count() + skipped * 1000;
+}
+
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void yield() { std::this_thread::yield(); }
+
+namespace host {
+  size_t freeHeap = 160 * 1024;
+  size_t largestBlock = 64 * 1024;
+  void advanceMillis(unsigned long ms) { skipped += ms; }
+}
+
+uint32_t EspClass::getFreeHeap() { return host::freeHeap; }
+uint32_t EspClass::getMaxAllocHeap() { return host::largestBlock; }
+EspClass ESP;
+
+size_t heap_caps_get_free_size(uint32_t) { return host::freeHeap; }
+size_t heap_caps_get_largest_free_block(uint32_t) { return host::largestBlock; }
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+static size_t print_formatted(Print& out, const char* format, va_list args) {
+  char buf[256];
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  if (len < 0) return 0;
+  return out.write((const uint8_t*) buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+size_t Print::printf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t n = print_formatted(*this, format, args);
+  va_end(args);
+  return n;
+}
+
+size_t Print::printf_P(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t n = print_formatted(*this, format, args);
+  va_end(args);
+  return n;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t n = 0;
+  int c;
+  while ((n < length) && ((c = read()) >= 0)) buffer[n++] = c;
+  return n;
+}
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buf);
+}
+
+/*
+ * FreeRTOS
+ * */
+
+struct host_semaphore {
+  std::mutex mutex;
+  std::condition_variable ready;
+  unsigned count;
+  unsigned max;
+};
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+  auto sem = new host_semaphore;
+  sem->count = initial;
+  sem->max = max;
+  return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+  std::unique_lock<std::mutex> lock(sem->mutex);
+  auto available = [sem]{ return sem->count > 0; };
+  if (wait == portMAX_DELAY) {
+    sem->ready.wait(lock, available);
+  } else if (!sem->ready.wait_for(lock, std::chrono::milliseconds(wait), available)) {
+    return pdFALSE;
+  }
+  --sem->count;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  std::lock_guard<std::mutex> lock(sem->mutex);
+  if (sem->count >= sem->max) return pdFALSE;
+  ++sem->count;
+  sem->ready.notify_one();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+struct host_task {};
+struct host_task_exit {};
+static thread_local host_task* current_task = nullptr;
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // Threads the harness didn't start get one on first use, freed as they exit
+  static thread_local std::unique_ptr<host_task> adopted;
+  if (!current_task) {
+    adopted.reset(new host_task);
+    current_task = adopted.get();
+  }
+  return current_task;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char*, uint32_t, void* arg, UBaseType_t, TaskHandle_t* handle) {
+  auto task = new host_task;
+  if (handle) *handle = task;
+  std::thread([fn, arg, task]{
+    current_task = task;
+    try {
+      fn(arg);
+    } catch (host_task_exit&) {
+    }
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* arg, UBaseType_t priority, TaskHandle_t* handle, BaseType_t) {
+  return xTaskCreate(fn, name, stack, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Only a task deleting itself is supported
+  if (!task || (task == current_task)) throw host_task_exit();
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+struct host_queue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::vector<char>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  auto queue = new host_queue;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+template<typename Pred> static bool wait_ticks(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TickType_t wait, Pred pred) {
+  if (wait == portMAX_DELAY) {
+    cv.wait(lock, pred);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(wait), pred);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!wait_ticks(lock, queue->changed, wait, [queue]{ return queue->items.size() < queue->length; })) return pdFALSE;
+  queue->items.emplace_back((const char*) item, (const char*) item + queue->itemSize);
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!wait_ticks(lock, queue->changed, wait, [queue]{ return !queue->items.empty(); })) return pdFALSE;
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->items.clear();
+  queue->changed.notify_all();
+  return pdPASS;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+/*
+ * Ticker: one timer thread for every ticker, like the esp_timer task
+ * */
+
+namespace {
+  struct Timer {
+    clock_type::time_point due;
+    Ticker* ticker;
+    uint32_t generation;
+    void (*callback)(void*);
+    void* arg;
+  };
+
+  struct Timers {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Timer> armed;
+    std::map<Ticker*, uint32_t> generations;
+    Ticker* running = nullptr;
+
+    Timers() { std::thread([this]{ loop(); }).detach(); }
+
+    void loop() {
+      current_task = new host_task;
+      std::unique_lock<std::mutex> lock(mutex);
+      for (;;) {
+        if (armed.empty()) {
+          changed.wait(lock);
+          continue;
+        }
+        auto next = std::min_element(armed.begin(), armed.end(), [](const Timer& a, const Timer& b){ return a.due < b.due; });
+        if (clock_type::now() < next->due) {
+          changed.wait_until(lock, next->due);
+          continue;
+        }
+        Timer timer = *next;
+        armed.erase(next);
+        auto current = generations.find(timer.ticker);
+        if ((current == generations.end()) || (current->second != timer.generation)) continue;
+        running = timer.ticker;
+        lock.unlock();
+        timer.callback(timer.arg);
+        lock.lock();
+        running = nullptr;
+        changed.notify_all();
+      }
+    }
+  };
+
+  // Never destroyed: the timer thread outlives static destruction
+  Timers& timers() {
+    static Timers* t = new Timers;
+    return *t;
+  }
+}
+
+Ticker::Ticker() : _generation(0) {}
+
+Ticker::~Ticker() {
+  auto& t = timers();
+  std::unique_lock<std::mutex> lock(t.mutex);
+  t.generations.erase(this);
+  t.changed.wait(lock, [&]{ return t.running != this; });
+}
+
+void Ticker::_attach(uint32_t milliseconds, void (*callback)(void*), void* arg) {
+  auto& t = timers();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  t.generations[this] = ++_generation;
+  t.armed.push_back({clock_type::now() + std::chrono::milliseconds(milliseconds), this, _generation, callback, arg});
+  t.changed.notify_all();
+}
+
+void Ticker::detach() {
+  auto& t = timers();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  t.generations[this] = ++_generation;
+}
+
+bool Ticker::active() const {
+  auto& t = timers();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  for (auto& timer : t.armed) {
+    if ((timer.ticker == this) && (timer.generation == _generation)) return true;
+  }
+  return false;
+}
+
+/*
+ * AsyncTCP
+ * */
+
+static AsyncServer* listening = nullptr;
+static uint16_t next_port = 40000;
+
+// The tcpip thread holds this while it runs a callback; clients link and unlink their pcb under it
+static std::mutex tcpip_lock;
+tcp_pcb* tcp_active_pcbs = nullptr;
+
+static void link_pcb(tcp_pcb* pcb) {
+  std::lock_guard<std::mutex> lock(tcpip_lock);
+  pcb->next = tcp_active_pcbs;
+  tcp_active_pcbs = pcb;
+}
+
+static void unlink_pcb(tcp_pcb* pcb) {
+  std::lock_guard<std::mutex> lock(tcpip_lock);
+  for (tcp_pcb** p = &tcp_active_pcbs; *p; p = &(*p)->next) {
+    if (*p == pcb) {
+      *p = pcb->next;
+      return;
+    }
+  }
+}
+
+namespace {
+  struct Tcpip {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::pair<tcpip_callback_fn, void*>> callbacks;
+
+    Tcpip() { std::thread([this]{ loop(); }).detach(); }
+
+    void loop() {
+      current_task = new host_task;
+      std::unique_lock<std::mutex> lock(mutex);
+      for (;;) {
+        changed.wait(lock, [this]{ return !callbacks.empty(); });
+        auto callback = callbacks.front();
+        callbacks.pop_front();
+        lock.unlock();
+        {
+          std::lock_guard<std::mutex> core(tcpip_lock);
+          callback.first(callback.second);
+        }
+        lock.lock();
+      }
+    }
+  };
+
+  // Never destroyed, like the timer thread
+  Tcpip& tcpip() {
+    static Tcpip* t = new Tcpip;
+    return *t;
+  }
+}
+
+err_t tcpip_try_callback(tcpip_callback_fn function, void* ctx) {
+  auto& t = tcpip();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  t.callbacks.emplace_back(function, ctx);
+  t.changed.notify_all();
+  return ERR_OK;
+}
+
+// Queues the poll for the network thread, which checks the client is still there before using it
+err_t AsyncClient::_s_poll(void* arg, tcp_pcb* pcb) {
+  host::post([arg, pcb]{
+    {
+      std::lock_guard<std::mutex> lock(tcpip_lock);
+      tcp_pcb* p = tcp_active_pcbs;
+      while (p && (p != pcb)) p = p->next;
+      if (!p || (p->callback_arg != arg)) return;
+    }
+    auto client = static_cast<AsyncClient*>(arg);
+    if (client->_connected && client->_poll) client->_poll(client->_pollArg, client);
+  });
+  return ERR_OK;
+}
+
+void AsyncServer::begin() { listening = this; }
+void AsyncServer::end() { if (listening == this) listening = nullptr; }
+
+AsyncClient::AsyncClient(host::Connection* connection)
+  : _connection(connection)
+  , _address(0x0100007f)
+  , _connected(connection != nullptr)
+  , _port(next_port++)
+  , _rxTimeout(0)
+  , _ackTimeout(0)
+  , _queued(0)
+  , _tcp{nullptr, this, _s_poll}
+  , _pcb(nullptr)
+  , _connectArg(nullptr), _discardArg(nullptr), _sentArg(nullptr), _errorArg(nullptr)
+  , _recvArg(nullptr), _timeoutArg(nullptr), _pollArg(nullptr)
+{
+  if (_connected) {
+    _pcb = &_tcp;
+    link_pcb(_pcb);
+  }
+}
+
+uint32_t AsyncClient::getRemoteAddress() const {
+  return _address;
+}
+
+AsyncClient::~AsyncClient() {
+  if (_pcb) unlink_pcb(_pcb);
+  if (_connection) _connection->client = nullptr;
+}
+
+size_t AsyncClient::space() {
+  if (!_connected || !_connection) return 0;
+  size_t used = _connection->unacked + _queued;
+  return (_connection->window > used) ? _connection->window - used : 0;
+}
+
+size_t AsyncClient::add(const char* data, size_t size, uint8_t) {
+  size = std::min(size, space());
+  if (!size) return 0;
+  _connection->output.append(data, size);
+  _queued += size;
+  return size;
+}
+
+bool AsyncClient::send() {
+  if (!_connected || !_connection) return false;
+  _connection->unacked += _queued;
+  _queued = 0;
+  return true;
+}
+
+size_t AsyncClient::write(const char* data) {
+  return data ? write(data, strlen(data)) : 0;
+}
+
+size_t AsyncClient::write(const char* data, size_t size, uint8_t apiflags) {
+  size_t added = add(data, size, apiflags);
+  if (!added || !send()) return 0;
+  return added;
+}
+
+void AsyncClient::close(bool) {
+  if (!_connected) return;
+  _connected = false;
+  unlink_pcb(_pcb);
+  _pcb = nullptr;
+  if (_connection) _connection->closed = true;
+  // The callback usually deletes us, so nothing may touch this afterwards
+  auto discard = _discard;
+  if (discard) discard(_discardArg, this);
+}
+
+namespace host {
+
+Connection::Connection(size_t window, uint32_t address)
+  : client(nullptr)
+  , unacked(0)
+  , window(window)
+  , closed(false)
+{
+  CHECK(listening);
+  client = new AsyncClient(this);
+  client->_address = address;
+  listening->_connect(listening->_connectArg, client);
+}
+
+Connection::~Connection() {
+  disconnect();
+  if (client) client->_connection = nullptr;
+}
+
+void Connection::receive(const char* data, size_t len) {
+  if (!client || !client->_connected || !client->_recv) return;
+  // The server may parse in place, so it gets a copy; kept between calls to stay out of the counts
+  static std::vector<char> copy;
+  if (copy.size() < len) copy.resize(len);
+  memcpy(copy.data(), data, len);
+  client->_recv(client->_recvArg, client, copy.data(), len);
+}
+
+void Connection::ack() {
+  if (!client || !client->_connected || !unacked) return;
+  size_t len = unacked;
+  unacked = 0;
+  if (client->_sent) client->_sent(client->_sentArg, client, len, 1);
+}
+
+void Connection::poll() {
+  if (client && client->_connected && client->_poll) client->_poll(client->_pollArg, client);
+}
+
+void Connection::disconnect() {
+  if (client) client->close(true);
+}
+
+static std::mutex posted_mutex;
+static std::condition_variable posted_changed;
+static std::deque<std::function<void()>> posted;
+
+void post(std::function<void()> fn) {
+  std::lock_guard<std::mutex> lock(posted_mutex);
+  posted.push_back(std::move(fn));
+  posted_changed.notify_all();
+}
+
+bool run(std::function<bool()> done, std::chrono::milliseconds timeout) {
+  auto until = clock_type::now() + timeout;
+  for (;;) {
+    if (done()) return true;
+    std::function<void()> next;
+    {
+      std::unique_lock<std::mutex> lock(posted_mutex);
+      if (!posted_changed.wait_until(lock, std::min(until, clock_type::now() + std::chrono::milliseconds(1)), []{ return !posted.empty(); })) {
+        if (clock_type::now() >= until) return done();
+        continue;
+      }
+      next = std::move(posted.front());
+      posted.pop_front();
+    }
+    next();
+  }
+}
+
+std::atomic<size_t> allocations(0);
+
+}
+
+/*
+ * Allocation counting (glibc only; the sanitizers bring their own allocator)
+ * */
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_THREAD__) && !defined(__SANITIZE_ADDRESS__)
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+
+  void* malloc(size_t size) {
+    host::allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t count, size_t size) {
+    host::allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* ptr, size_t size) {
+    host::allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+  }
+}
+#endif
+
+/*
+ * Filesystem
+ * */
+
+namespace fs {
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!_data) return 0;
+  _data->replace(_pos, std::min(size, _data->size() - _pos), (const char*) buf, size);
+  _pos += size;
+  return size;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  size = std::min<size_t>(size, available());
+  if (size) memcpy(buf, _data->data() + _pos, size);
+  _pos += size;
+  return size;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? _pos : size();
+  if (base + pos > size()) return false;
+  _pos = base + pos;
+  return true;
+}
+
+File FS::open(const String& path, const char* mode) {
+  auto it = _files.find(path.c_str());
+  if (mode[0] == 'w') {
+    auto data = std::make_shared<std::string>();
+    _files[path.c_str()] = data;
+    return File(path, data);
+  }
+  if (it == _files.end()) return File();
+  return File(path, it->second);
+}
+
+}
+
+/*
+ * base64 and MD5, for WebAuthentication
+ * */
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+extern "C" {
+
+void base64_init_encodestate(base64_encodestate* state) {
+  state->step = step_A;
+  state->result = 0;
+  state->stepcount = 0;
+}
+
+int base64_encode_block(const char* plaintext, int length, char* code_out, base64_encodestate* state) {
+  char* out = code_out;
+  for (int i = 0; i < length; ++i) {
+    uint8_t c = plaintext[i];
+    switch (state->step) {
+      case step_A:
+        *out++ = base64_chars[c >> 2];
+        state->result = (c & 0x03) << 4;
+        state->step = step_B;
+        break;
+      case step_B:
+        *out++ = base64_chars[state->result | (c >> 4)];
+        state->result = (c & 0x0f) << 2;
+        state->step = step_C;
+        break;
+      case step_C:
+        *out++ = base64_chars[state->result | (c >> 6)];
+        *out++ = base64_chars[c & 0x3f];
+        state->step = step_A;
+        break;
+    }
+  }
+  return out - code_out;
+}
+
+int base64_encode_blockend(char* code_out, base64_encodestate* state) {
+  char* out = code_out;
+  if (state->step == step_B) {
+    *out++ = base64_chars[(int) state->result];
+    *out++ = '=';
+    *out++ = '=';
+  } else if (state->step == step_C) {
+    *out++ = base64_chars[(int) state->result];
+    *out++ = '=';
+  }
+  *out = 0;
+  return out - code_out;
+}
+
+int base64_encode_expected_len(int plaintext_len) {
+  return ((plaintext_len + 2) / 3) * 4;
+}
+
+int base64_encode_chars(const char* plaintext, int length, char* code_out) {
+  base64_encodestate state;
+  base64_init_encodestate(&state);
+  int len = base64_encode_block(plaintext, length, code_out, &state);
+  return len + base64_encode_blockend(code_out + len, &state);
+}
+
+}
+
+static void md5_block(uint32_t state[4], const unsigned char block[64]) {
+  static const uint32_t k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+  };
+  static const uint8_t r[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+  };
+  uint32_t w[16];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) | ((uint32_t) block[i * 4 + 3] << 24);
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  for (int i = 0; i < 64; ++i) {
+    uint32_t f, g;
+    if (i < 16) { f = (b & c) | (~b & d); g = i; }
+    else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+    else if (i < 48) { f = b ^ c ^ d; g = (3 * i + 5) % 16; }
+    else { f = c ^ (b | ~d); g = (7 * i) % 16; }
+    uint32_t t = d;
+    d = c;
+    c = b;
+    uint32_t x = a + f + k[i] + w[g];
+    b = b + ((x << r[i]) | (x >> (32 - r[i])));
+    a = t;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+}
+
+void mbedtls_md5_init(mbedtls_md5_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_md5_free(mbedtls_md5_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+
+int mbedtls_md5_starts_ret(mbedtls_md5_context* ctx) {
+  ctx->total[0] = ctx->total[1] = 0;
+  ctx->state[0] = 0x67452301;
+  ctx->state[1] = 0xefcdab89;
+  ctx->state[2] = 0x98badcfe;
+  ctx->state[3] = 0x10325476;
+  return 0;
+}
+
+int mbedtls_md5_update_ret(mbedtls_md5_context* ctx, const unsigned char* input, size_t ilen) {
+  size_t fill = ctx->total[0] & 63;
+  ctx->total[0] += ilen;   // byte count; 4 GiB is plenty here
+  while (ilen) {
+    size_t n = std::min(ilen, 64 - fill);
+    memcpy(ctx->buffer + fill, input, n);
+    fill += n;
+    input += n;
+    ilen -= n;
+    if (fill == 64) {
+      md5_block(ctx->state, ctx->buffer);
+      fill = 0;
+    }
+  }
+  return 0;
+}
+
+int mbedtls_md5_finish_ret(mbedtls_md5_context* ctx, unsigned char output[16]) {
+  uint64_t bits = (uint64_t) ctx->total[0] * 8;
+  static const unsigned char pad[64] = {0x80};
+  size_t fill = ctx->total[0] & 63;
+  mbedtls_md5_update_ret(ctx, pad, (fill < 56) ? 56 - fill : 120 - fill);
+  unsigned char length[8];
+  for (int i = 0; i < 8; ++i) length[i] = bits >> (8 * i);
+  mbedtls_md5_update_ret(ctx, length, 8);
+  for (int i = 0; i < 16; ++i) output[i] = ctx->state[i / 4] >> (8 * (i % 4));
+  return 0;
+}
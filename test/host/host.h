@@ -0,0 +1,41 @@
+// Test side of the host harness: drive connections into an AsyncWebServer and look at what it
+// sends back.  The thread that drives a connection plays the async_tcp task for it.
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+
+namespace host {
+
+struct Connection {
+  AsyncClient* client;    // cleared when the library deletes it
+  std::string output;     // everything the server has sent
+  size_t unacked;         // sent and not yet acknowledged
+  size_t window;          // what space() reports while nothing is in flight
+  bool closed;            // closed by the server
+
+  explicit Connection(size_t window = 5744, uint32_t address = 0x0100007f);
+  ~Connection();
+
+  void receive(const char* data, size_t len);
+  void receive(const std::string& data) { receive(data.data(), data.size()); }
+  void ack();             // acknowledge everything sent so far
+  void poll();
+  void disconnect();      // the peer goes away
+};
+
+// Runs fn on the network thread at its next run(); safe to call from any thread
+void post(std::function<void()> fn);
+
+// Services posted work on the calling thread until done() holds or the timeout passes
+bool run(std::function<bool()> done, std::chrono::milliseconds timeout);
+
+// Allocation counter, fed by the malloc wrapper the benchmarks link with
+extern std::atomic<size_t> allocations;
+
+}
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); exit(1); } } while (0)
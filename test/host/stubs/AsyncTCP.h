@@ -0,0 +1,105 @@
+// Host stand-in for AsyncTCP: a client is driven by the test through host::Connection (host.h)
+// instead of lwIP.  Callbacks run on whichever thread the test drives the connection from,
+// which plays the part of the async_tcp task.
+#pragma once
+
+#include "Arduino.h"
+#include "lwip/tcp.h"
+
+#define TCP_MSS 1436
+#define ASYNC_WRITE_FLAG_COPY 0x01
+#define ASYNC_WRITE_FLAG_MORE 0x02
+#define IPADDR_ANY ((uint32_t) 0x00000000UL)
+
+class AsyncClient;
+namespace host { struct Connection; }
+
+typedef std::function<void(void*, AsyncClient*)> AcConnectHandler;
+typedef std::function<void(void*, AsyncClient*, size_t len, uint32_t time)> AcAckHandler;
+typedef std::function<void(void*, AsyncClient*, int8_t error)> AcErrorHandler;
+typedef std::function<void(void*, AsyncClient*, void* data, size_t len)> AcDataHandler;
+typedef std::function<void(void*, AsyncClient*, uint32_t time)> AcTimeoutHandler;
+
+class AsyncClient {
+  public:
+    AsyncClient(host::Connection* connection = nullptr);
+    ~AsyncClient();
+
+    size_t add(const char* data, size_t size, uint8_t apiflags = ASYNC_WRITE_FLAG_COPY);
+    bool send();
+    size_t write(const char* data);
+    size_t write(const char* data, size_t size, uint8_t apiflags = ASYNC_WRITE_FLAG_COPY);
+    size_t space();
+    bool canSend() { return space() > 0; }
+    void close(bool now = false);
+    void abort() { close(true); }
+    int8_t free() { return 0; }
+    bool connected() const { return _connected; }
+    bool disconnected() const { return !_connected; }
+    bool freeable() const { return !_connected; }
+    tcp_pcb* pcb() { return _pcb; }   // while connected, linked into tcp_active_pcbs
+    const char* stateToString() const { return _connected ? "Established" : "Closed"; }
+
+    void setRxTimeout(uint32_t timeout) { _rxTimeout = timeout; }
+    uint32_t getRxTimeout() const { return _rxTimeout; }
+    void setAckTimeout(uint32_t timeout) { _ackTimeout = timeout; }
+    void setNoDelay(bool) {}
+    void ackLater() {}
+    size_t ack(size_t len) { return len; }
+
+    uint32_t getRemoteAddress() const;
+    uint16_t getRemotePort() const { return _port; }
+    uint32_t getLocalAddress() const { return 0x0100007f; }
+    uint16_t getLocalPort() const { return 80; }
+    IPAddress remoteIP() const { return IPAddress(getRemoteAddress()); }
+    uint16_t remotePort() const { return getRemotePort(); }
+    IPAddress localIP() const { return IPAddress(getLocalAddress()); }
+    uint16_t localPort() const { return getLocalPort(); }
+
+    void onConnect(AcConnectHandler cb, void* arg = 0) { _connect = cb; _connectArg = arg; }
+    void onDisconnect(AcConnectHandler cb, void* arg = 0) { _discard = cb; _discardArg = arg; }
+    void onAck(AcAckHandler cb, void* arg = 0) { _sent = cb; _sentArg = arg; }
+    void onError(AcErrorHandler cb, void* arg = 0) { _error = cb; _errorArg = arg; }
+    void onData(AcDataHandler cb, void* arg = 0) { _recv = cb; _recvArg = arg; }
+    void onTimeout(AcTimeoutHandler cb, void* arg = 0) { _timeout = cb; _timeoutArg = arg; }
+    void onPoll(AcConnectHandler cb, void* arg = 0) { _poll = cb; _pollArg = arg; }
+
+  private:
+    friend struct host::Connection;
+    host::Connection* _connection;
+    uint32_t _address;
+    bool _connected;
+    uint16_t _port;
+    uint32_t _rxTimeout;
+    uint32_t _ackTimeout;
+    size_t _queued;         // added and not yet sent
+    tcp_pcb _tcp;
+    tcp_pcb* _pcb;
+
+    static err_t _s_poll(void* arg, tcp_pcb* pcb);   // on the tcpip thread, like AsyncTCP's
+
+    AcConnectHandler _connect; void* _connectArg;
+    AcConnectHandler _discard; void* _discardArg;
+    AcAckHandler _sent; void* _sentArg;
+    AcErrorHandler _error; void* _errorArg;
+    AcDataHandler _recv; void* _recvArg;
+    AcTimeoutHandler _timeout; void* _timeoutArg;
+    AcConnectHandler _poll; void* _pollArg;
+};
+
+class AsyncServer {
+  public:
+    AsyncServer(IPAddress addr, uint16_t port) : _port(port) { (void) addr; }
+    AsyncServer(uint16_t port) : _port(port) {}
+    ~AsyncServer() { end(); }
+    void onClient(AcConnectHandler cb, void* arg) { _connect = cb; _connectArg = arg; }
+    void begin();
+    void end();
+    void setNoDelay(bool) {}
+
+  private:
+    friend struct host::Connection;
+    uint16_t _port;
+    AcConnectHandler _connect;
+    void* _connectArg;
+};
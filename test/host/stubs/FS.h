@@ -0,0 +1,61 @@
+// Host stand-in for the Arduino filesystem: an in-memory map of paths to contents
+#pragma once
+
+#include "Arduino.h"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+  public:
+    File() : _pos(0) {}
+    File(const String& name, std::shared_ptr<std::string> data) : _name(name), _data(data), _pos(0) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override { return _data ? _data->size() - _pos : 0; }
+    int read() override { return available() ? (uint8_t) (*_data)[_pos++] : -1; }
+    int peek() override { return available() ? (uint8_t) (*_data)[_pos] : -1; }
+    size_t read(uint8_t* buf, size_t size);
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const { return _pos; }
+    size_t size() const { return _data ? _data->size() : 0; }
+    void close() { _data.reset(); _pos = 0; }
+    operator bool() const { return (bool) _data; }
+    const char* name() const { return _name.c_str(); }
+    const char* path() const { return _name.c_str(); }
+    bool isDirectory() const { return false; }
+    time_t getLastWrite() { return 0; }
+
+  private:
+    String _name;
+    std::shared_ptr<std::string> _data;
+    size_t _pos;
+};
+
+class FS {
+  public:
+    File open(const String& path, const char* mode = "r");
+    File open(const char* path, const char* mode = "r") { return open(String(path), mode); }
+    bool exists(const String& path) const { return _files.count(path.c_str()) != 0; }
+    bool exists(const char* path) const { return exists(String(path)); }
+    bool remove(const String& path) { return _files.erase(path.c_str()) != 0; }
+    void put(const String& path, const std::string& contents) { _files[path.c_str()] = std::make_shared<std::string>(contents); }
+
+  private:
+    std::map<std::string, std::shared_ptr<std::string>> _files;
+};
+
+}
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
@@ -0,0 +1,20 @@
+// Host stand-in for the ESP32 Ticker: callbacks run on one shared timer thread, as they do on
+// the esp_timer task
+#pragma once
+
+#include <stdint.h>
+
+class Ticker {
+  public:
+    Ticker();
+    ~Ticker();
+    template<typename TArg> void once_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg) {
+      _attach(milliseconds, reinterpret_cast<void (*)(void*)>(callback), (void*) arg);
+    }
+    void detach();
+    bool active() const;
+
+  private:
+    void _attach(uint32_t milliseconds, void (*callback)(void*), void* arg);
+    uint32_t _generation;
+};
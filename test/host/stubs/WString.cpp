@@ -0,0 +1,252 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utility>
+
+String::String(const char* cstr) { init(); if(cstr) copy(cstr, strlen(cstr)); }
+String::String(const char* cstr, unsigned int length) { init(); if(cstr) copy(cstr, length); }
+String::String(const String& str) { init(); *this = str; }
+String::String(String&& rval) noexcept { init(); move(rval); }
+String::String(const __FlashStringHelper* str) : String(reinterpret_cast<const char*>(str)) {}
+String::String(char c) { init(); copy(&c, 1); }
+
+static String formatted(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static String formatted(const char* fmt, ...){
+  char buf[72];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  return String(buf);
+}
+
+static String based(unsigned long long value, bool negative, unsigned char base){
+  if(base == 10) return negative ? formatted("-%llu", value) : formatted("%llu", value);
+  char buf[72];
+  char* p = buf + sizeof(buf) - 1;
+  *p = 0;
+  do {
+    const unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while(value);
+  if(negative) *--p = '-';
+  return String(p);
+}
+
+String::String(unsigned char value, unsigned char base) : String(based(value, false, base)) {}
+String::String(int value, unsigned char base) : String((long long) value, base) {}
+String::String(unsigned int value, unsigned char base) : String(based(value, false, base)) {}
+String::String(long value, unsigned char base) : String((long long) value, base) {}
+String::String(unsigned long value, unsigned char base) : String(based(value, false, base)) {}
+String::String(long long value, unsigned char base) : String(based(value < 0 ? -(unsigned long long) value : value, value < 0, base)) {}
+String::String(unsigned long long value, unsigned char base) : String(based(value, false, base)) {}
+String::String(float value, unsigned char decimalPlaces) : String((double) value, decimalPlaces) {}
+String::String(double value, unsigned char decimalPlaces) : String(formatted("%.*f", decimalPlaces, value)) {}
+
+String::~String() { invalidate(); }
+
+void String::invalidate(){
+  if(!isSSO() && ptr.buff) free(ptr.buff);
+  init();
+}
+
+bool String::reserve(unsigned int size){
+  if(buffer() && (capacity() >= size)) return true;
+  if(changeBuffer(size)){
+    if(len() == 0) wbuffer()[0] = 0;
+    return true;
+  }
+  return false;
+}
+
+// As the core does: small strings live in the object, larger ones get a heap buffer
+bool String::changeBuffer(unsigned int maxStrLen){
+  if(maxStrLen < sizeof(sso.buff) - 1){
+    if(isSSO() || !buffer()){
+      if(!isSSO()){
+        init();
+        setSSO(true);
+      }
+      return true;
+    }
+    // Heap to SSO
+    char temp[sizeof(sso.buff)];
+    memcpy(temp, buffer(), maxStrLen);
+    free(wbuffer());
+    unsigned int oldLen = len();
+    init();
+    setSSO(true);
+    memcpy(sso.buff, temp, maxStrLen);
+    setLen(oldLen < maxStrLen ? oldLen : maxStrLen);
+    return true;
+  }
+  size_t newSize = (maxStrLen + 16) & (~0xf);   // rounded up, as the core does
+  if(!isSSO() && buffer() && (newSize <= capacity() + 1)) return true;
+  unsigned int oldLen = len();
+  char* newbuffer = (char*) realloc(isSSO() ? nullptr : wbuffer(), newSize);
+  if(!newbuffer) return false;
+  if(isSSO()){
+    memcpy(newbuffer, sso.buff, sizeof(sso.buff));
+  }
+  init();
+  setSSO(false);
+  setBuffer(newbuffer);
+  setCapacity(newSize - 1);
+  setLen(oldLen);
+  return true;
+}
+
+String& String::copy(const char* cstr, unsigned int length){
+  if(!reserve(length)){
+    invalidate();
+    return *this;
+  }
+  memmove(wbuffer(), cstr, length);
+  wbuffer()[length] = 0;
+  setLen(length);
+  return *this;
+}
+
+void String::move(String& rhs){
+  if(this == &rhs) return;
+  invalidate();
+  memcpy(raw, rhs.raw, sizeof(raw));
+  rhs.init();
+}
+
+String& String::operator=(const String& rhs){
+  if(this == &rhs) return *this;
+  if(rhs.buffer()) copy(rhs.buffer(), rhs.len()); else invalidate();
+  return *this;
+}
+
+String& String::operator=(String&& rval) noexcept { move(rval); return *this; }
+String& String::operator=(const char* cstr){ if(cstr) copy(cstr, strlen(cstr)); else invalidate(); return *this; }
+String& String::operator=(const __FlashStringHelper* str){ return *this = reinterpret_cast<const char*>(str); }
+String& String::operator=(char c){ return copy(&c, 1); }
+
+bool String::concat(const char* cstr, unsigned int length){
+  if(!cstr) return false;
+  if(!length) return true;
+  const unsigned int oldLen = len();
+  if(buffer() && (cstr >= buffer()) && (cstr < buffer() + oldLen)){
+    // Appending part of ourselves
+    String tmp(cstr, length);
+    return concat(tmp.c_str(), length);
+  }
+  if(!reserve(oldLen + length)) return false;
+  memcpy(wbuffer() + oldLen, cstr, length);
+  setLen(oldLen + length);
+  wbuffer()[oldLen + length] = 0;
+  return true;
+}
+
+int String::compareTo(const String& s) const { return strcmp(c_str(), s.c_str()); }
+
+bool String::equalsIgnoreCase(const String& s) const {
+  return (len() == s.len()) && !strcasecmp(c_str(), s.c_str());
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+  if(offset + prefix.len() > len()) return false;
+  return !strncmp(c_str() + offset, prefix.c_str(), prefix.len());
+}
+
+bool String::endsWith(const String& suffix) const {
+  if(suffix.len() > len()) return false;
+  return !strcmp(c_str() + len() - suffix.len(), suffix.c_str());
+}
+
+char& String::operator[](unsigned int index){
+  static char dummy;
+  if(index >= len()){
+    dummy = 0;
+    return dummy;
+  }
+  return wbuffer()[index];
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if(fromIndex >= len()) return -1;
+  const char* p = (const char*) memchr(buffer() + fromIndex, ch, len() - fromIndex);
+  return p ? p - buffer() : -1;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  if(fromIndex > len()) return -1;
+  const char* p = strstr(c_str() + fromIndex, str.c_str());
+  return p ? p - c_str() : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+  if(!len()) return -1;
+  const char* p = strrchr(buffer(), ch);
+  return p ? p - buffer() : -1;
+}
+
+int String::lastIndexOf(const String& str) const {
+  if(str.len() > len()) return -1;
+  for(int i = len() - str.len(); i >= 0; --i){
+    if(!strncmp(buffer() + i, str.c_str(), str.len())) return i;
+  }
+  return -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if(beginIndex > endIndex) std::swap(beginIndex, endIndex);
+  if(beginIndex >= len()) return String();
+  if(endIndex > len()) endIndex = len();
+  return String(buffer() + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace){
+  char* p = wbuffer();
+  for(unsigned i = 0; i < len(); ++i) if(p[i] == find) p[i] = replace;
+}
+
+void String::replace(const String& find, const String& replace){
+  if(!find.len()) return;
+  String result;
+  int from = 0, at;
+  while((at = indexOf(find, from)) >= 0){
+    result.concat(buffer() + from, at - from);
+    result.concat(replace);
+    from = at + find.len();
+  }
+  result.concat(c_str() + from, len() - from);
+  *this = std::move(result);
+}
+
+void String::remove(unsigned int index, unsigned int count){
+  if(index >= len()) return;
+  if(count > len() - index) count = len() - index;
+  char* p = wbuffer();
+  memmove(p + index, p + index + count, len() - index - count + 1);
+  setLen(len() - count);
+}
+
+void String::toLowerCase(){ char* p = wbuffer(); for(unsigned i = 0; i < len(); ++i) p[i] = tolower((unsigned char) p[i]); }
+void String::toUpperCase(){ char* p = wbuffer(); for(unsigned i = 0; i < len(); ++i) p[i] = toupper((unsigned char) p[i]); }
+
+void String::trim(){
+  if(!len()) return;
+  char* p = wbuffer();
+  unsigned begin = 0, end = len();
+  while((begin < end) && isspace((unsigned char) p[begin])) ++begin;
+  while((end > begin) && isspace((unsigned char) p[end - 1])) --end;
+  memmove(p, p + begin, end - begin);
+  setLen(end - begin);
+  p[end - begin] = 0;
+}
+
+long String::toInt() const { return atol(c_str()); }
+float String::toFloat() const { return atof(c_str()); }
+
+String operator+(const String& lhs, const String& rhs){ String s(lhs); s.concat(rhs); return s; }
+String operator+(const String& lhs, const char* rhs){ String s(lhs); s.concat(rhs); return s; }
+String operator+(const char* lhs, const String& rhs){ String s(lhs); s.concat(rhs); return s; }
+String operator+(const String& lhs, char rhs){ String s(lhs); s.concat(rhs); return s; }
+String operator+(const String& lhs, const __FlashStringHelper* rhs){ String s(lhs); s.concat(rhs); return s; }
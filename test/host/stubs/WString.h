@@ -0,0 +1,142 @@
+// Host stand-in for the ESP32 Arduino core's String: same interface as far as the library uses
+// it, including the protected buffer accessors DynamicBuffer relies on, and the same small-string
+// buffer size, so allocation counts match the device.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class __FlashStringHelper;
+
+class String {
+  public:
+    String(const char* cstr = "");
+    String(const char* cstr, unsigned int length);
+    String(const String& str);
+    String(String&& rval) noexcept;
+    String(const __FlashStringHelper* str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(String&& rval) noexcept;
+    String& operator=(const char* cstr);
+    String& operator=(const __FlashStringHelper* str);
+    String& operator=(char c);
+
+    bool reserve(unsigned int size);
+    unsigned int length() const { return len(); }
+    bool isEmpty() const { return !len(); }
+    const char* c_str() const { return buffer() ? buffer() : ""; }
+    char* begin() { return wbuffer(); }
+    char* end() { return wbuffer() + len(); }
+    const char* begin() const { return c_str(); }
+    const char* end() const { return c_str() + len(); }
+    explicit operator bool() const { return buffer() != nullptr; }
+
+    bool concat(const String& str) { return concat(str.c_str(), str.length()); }
+    bool concat(const char* cstr) { return cstr && concat(cstr, strlen(cstr)); }
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(const __FlashStringHelper* str) { return concat(reinterpret_cast<const char*>(str)); }
+    bool concat(char c) { return concat(&c, 1); }
+    bool concat(unsigned char value) { return concat(String(value)); }
+    bool concat(int value) { return concat(String(value)); }
+    bool concat(unsigned int value) { return concat(String(value)); }
+    bool concat(long value) { return concat(String(value)); }
+    bool concat(unsigned long value) { return concat(String(value)); }
+    bool concat(long long value) { return concat(String(value)); }
+    bool concat(unsigned long long value) { return concat(String(value)); }
+    bool concat(float value) { return concat(String(value)); }
+    bool concat(double value) { return concat(String(value)); }
+
+    template<typename T> String& operator+=(const T& rhs) { concat(rhs); return *this; }
+    String& operator+=(const char* cstr) { concat(cstr); return *this; }
+
+    int compareTo(const String& s) const;
+    bool equals(const String& s) const { return (len() == s.len()) && !compareTo(s); }
+    bool equals(const char* cstr) const { return !strcmp(c_str(), cstr ? cstr : ""); }
+    bool operator==(const String& rhs) const { return equals(rhs); }
+    bool operator==(const char* cstr) const { return equals(cstr); }
+    bool operator==(const __FlashStringHelper* rhs) const { return equals(reinterpret_cast<const char*>(rhs)); }
+    bool operator!=(const String& rhs) const { return !equals(rhs); }
+    bool operator!=(const char* cstr) const { return !equals(cstr); }
+    bool operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+    bool equalsIgnoreCase(const String& s) const;
+    bool startsWith(const String& prefix) const { return startsWith(prefix, 0); }
+    bool startsWith(const String& prefix, unsigned int offset) const;
+    bool endsWith(const String& suffix) const;
+
+    char charAt(unsigned int index) const { return (*this)[index]; }
+    void setCharAt(unsigned int index, char c) { if(index < len()) wbuffer()[index] = c; }
+    char operator[](unsigned int index) const { return (index < len()) ? buffer()[index] : 0; }
+    char& operator[](unsigned int index);
+
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    int indexOf(const String& str, unsigned int fromIndex = 0) const;
+    int indexOf(const char* str, unsigned int fromIndex = 0) const { return indexOf(String(str), fromIndex); }
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(const String& str) const;
+    String substring(unsigned int beginIndex) const { return substring(beginIndex, len()); }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String& find, const String& replace);
+    void remove(unsigned int index) { remove(index, (unsigned int) -1); }
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+    long toInt() const;
+    float toFloat() const;
+
+  protected:
+    // Same layout as the core: a heap pointer, or up to 15 bytes kept in the object itself
+    struct _ptr {
+      char* buff;
+      uint32_t cap;
+      uint32_t len;
+    };
+    enum { SSOSIZE = 16 };
+    struct _sso {
+      char buff[SSOSIZE - 1];
+      unsigned char len : 7;
+      unsigned char isSSO : 1;
+    } __attribute__((packed));
+    union {
+      struct _ptr ptr;
+      struct _sso sso;
+      char raw[sizeof(struct _ptr) > SSOSIZE ? sizeof(struct _ptr) : SSOSIZE];
+    };
+
+    bool isSSO() const { return sso.isSSO; }
+    unsigned int len() const { return isSSO() ? sso.len : ptr.len; }
+    unsigned int capacity() const { return isSSO() ? (unsigned int) SSOSIZE - 2 : ptr.cap; }
+    void setSSO(bool set) { sso.isSSO = set; }
+    void setLen(int len) { if (isSSO()) sso.len = len; else ptr.len = len; }
+    void setCapacity(int cap) { if (!isSSO()) ptr.cap = cap; }
+    void setBuffer(char* buff) { if (!isSSO()) ptr.buff = buff; }
+    const char* buffer() const { return isSSO() ? sso.buff : ptr.buff; }
+    char* wbuffer() const { return isSSO() ? const_cast<char*>(sso.buff) : ptr.buff; }
+
+    void init() { memset(raw, 0, sizeof(raw)); }
+    void invalidate();
+    bool changeBuffer(unsigned int maxStrLen);
+    String& copy(const char* cstr, unsigned int length);
+    void move(String& rhs);
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+String operator+(const String& lhs, const __FlashStringHelper* rhs);
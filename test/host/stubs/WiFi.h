@@ -0,0 +1,7 @@
+#pragma once
+#include "Arduino.h"
+
+struct WiFiClass {
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+};
+extern WiFiClass WiFi;
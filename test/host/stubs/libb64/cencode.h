@@ -0,0 +1,21 @@
+#pragma once
+
+typedef enum { step_A, step_B, step_C } base64_encodestep;
+
+typedef struct {
+  base64_encodestep step;
+  char result;
+  int stepcount;
+} base64_encodestate;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void base64_init_encodestate(base64_encodestate* state);
+int base64_encode_block(const char* plaintext, int length, char* code_out, base64_encodestate* state);
+int base64_encode_blockend(char* code_out, base64_encodestate* state);
+int base64_encode_expected_len(int plaintext_len);
+int base64_encode_chars(const char* plaintext, int length, char* code_out);
+#ifdef __cplusplus
+}
+#endif
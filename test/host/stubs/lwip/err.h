@@ -0,0 +1,8 @@
+// Host stand-in for lwIP's error type
+#pragma once
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+#define ERR_OK 0
+#define ERR_MEM -1
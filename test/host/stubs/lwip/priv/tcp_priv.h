@@ -0,0 +1,6 @@
+// Host stand-in for lwIP's list of active connections
+#pragma once
+
+#include "lwip/tcp.h"
+
+extern struct tcp_pcb* tcp_active_pcbs;
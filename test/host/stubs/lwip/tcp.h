@@ -0,0 +1,14 @@
+// Host stand-in for the parts of lwIP's tcp_pcb the library looks at.  Each host AsyncClient has
+// one, linked into tcp_active_pcbs while it is connected.
+#pragma once
+
+#include "lwip/err.h"
+
+struct tcp_pcb;
+typedef err_t (*tcp_poll_fn)(void* arg, struct tcp_pcb* tpcb);
+
+struct tcp_pcb {
+  struct tcp_pcb* next;
+  void* callback_arg;
+  tcp_poll_fn poll;
+};
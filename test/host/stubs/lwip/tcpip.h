@@ -0,0 +1,8 @@
+// Host stand-in for lwIP's tcpip thread: callbacks run in order on a thread of their own, holding
+// the lock that guards tcp_active_pcbs
+#pragma once
+
+#include "lwip/err.h"
+
+typedef void (*tcpip_callback_fn)(void* ctx);
+err_t tcpip_try_callback(tcpip_callback_fn function, void* ctx);
@@ -0,0 +1,71 @@
+// Queue fairness: clients take turns, but the earliest waiting request must not starve while
+// its client has a long request running and other clients keep arriving
+#include "host.h"
+#include <memory>
+#include <vector>
+
+static AsyncWebServer server(80);
+
+static std::vector<AsyncWebServerRequest*> running;
+static std::vector<std::string> started;
+
+static void hold(AsyncWebServerRequest* request) {
+  running.push_back(request);
+  started.push_back(request->url().c_str());
+}
+
+static void finish(const char* url) {
+  for (auto it = running.begin(); it != running.end(); ++it) {
+    if ((*it)->url() == url) {
+      AsyncWebServerRequest* request = *it;
+      running.erase(it);
+      request->send(204);
+      return;
+    }
+  }
+  CHECK(false);
+}
+
+static const uint32_t clientA = 0x0200000a, clientB = 0x0300000a;
+
+static std::string get(const std::string& url) {
+  return "GET " + url + " HTTP/1.1\r\nHost: device.local\r\n\r\n";
+}
+
+int main() {
+  server.on("/a/slow", HTTP_GET, hold);
+  server.on("/a/next", HTTP_GET, hold);
+  server.on("/b", HTTP_GET, hold);
+  AsyncWebServerQueueLimits limits = { 2, 32, 0, 0, { 0, 0, 0 }, 0, 0 };
+  server.setQueueLimits(limits);
+  server.begin();
+
+  // A's long request and B's first take both places; A's next request is then first in line
+  host::Connection slow(5744, clientA), next(5744, clientA);
+  std::vector<std::unique_ptr<host::Connection>> b;
+  slow.receive(get("/a/slow"));
+  b.emplace_back(new host::Connection(5744, clientB));
+  b.back()->receive(get("/b"));
+  next.receive(get("/a/next"));
+  CHECK(started.size() == 2);
+
+  // B keeps a request waiting behind A's; each time B's running one finishes, a place frees up
+  int b_starts = 0;
+  for (int i = 0; (i < 20) && (started.back() != "/a/next"); ++i) {
+    b.emplace_back(new host::Connection(5744, clientB));
+    b.back()->receive(get("/b"));
+    finish("/b");
+    b[b.size() - 2]->ack();
+    if (started.back() == "/b") ++b_starts;
+  }
+  CHECK(started.back() == "/a/next");
+  CHECK(b_starts > 0);    // B was preferred while A had a request running...
+  CHECK(b_starts <= 4);   // ...but only for a while
+
+  finish("/a/slow");
+  finish("/a/next");
+  while (!running.empty()) finish("/b");
+  server.end();
+  printf("test_fair_queue: ok\n");
+  return 0;
+}
@@ -0,0 +1,136 @@
+// Request head parsing: the same requests must parse identically however TCP splits them
+#include "host.h"
+
+static AsyncWebServer server(80);
+
+struct Seen {
+  int requests = 0;
+  WebRequestMethodComposite method = 0;
+  String url;
+  uint8_t version = 0;
+  String host;
+  String agent;
+  String custom;
+  String query;
+  String field;
+  size_t headers = 0;
+};
+static Seen seen;
+
+static void record(AsyncWebServerRequest* request) {
+  ++seen.requests;
+  seen.method = request->method();
+  seen.url = request->url();
+  seen.version = request->version();
+  seen.host = request->header(HDR_HOST);
+  seen.agent = request->hasHeader("User-Agent") ? request->getHeader("user-agent")->value() : String("-");
+  seen.custom = request->hasHeader("X-Custom") ? request->getHeader("X-Custom")->value() : String("-");
+  seen.query = request->hasArg("q") ? request->arg("q") : String("-");
+  seen.field = request->hasParam("field", true) ? request->getParam("field", true)->value() : String("-");
+  seen.headers = request->headers();
+  request->send(200, "text/plain", "ok");
+}
+
+static const std::string get =
+  "GET /echo?q=a%20b&x=1 HTTP/1.1\r\n"
+  "Host: device.local\r\n"
+  "User-Agent:   curl/8.0  \r\n"
+  "Accept: */*\r\n"
+  "X-Custom: one\r\n"
+  "\r\n";
+
+static const std::string post =
+  "POST /echo HTTP/1.1\r\n"
+  "Host: device.local\r\n"
+  "Content-Type: application/x-www-form-urlencoded\r\n"
+  "Content-Length: 17\r\n"
+  "\r\n"
+  "field=hello+there";
+
+// Feeds the request in pieces of the given size, then returns what the server sent back
+static std::string exchange(const std::string& request, size_t piece) {
+  seen = Seen();
+  host::Connection c;
+  for (size_t at = 0; at < request.size(); at += piece) {
+    c.receive(request.substr(at, piece));
+  }
+  c.ack();
+  return c.output;
+}
+
+static void check_get(size_t piece) {
+  std::string out = exchange(get, piece);
+  CHECK(out.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+  CHECK(seen.requests == 1);
+  CHECK(seen.method == HTTP_GET);
+  CHECK(seen.url == "/echo");
+  CHECK(seen.version == 1);
+  CHECK(seen.host == "device.local");
+  CHECK(seen.agent == "curl/8.0");
+  CHECK(seen.custom == "one");
+  CHECK(seen.query == "a b");
+  CHECK(seen.headers == 4);
+}
+
+static void check_post(size_t piece) {
+  std::string out = exchange(post, piece);
+  CHECK(out.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+  CHECK(seen.requests == 1);
+  CHECK(seen.method == HTTP_POST);
+  CHECK(seen.field == "hello there");
+}
+
+static void check_refused(const std::string& request, const char* status) {
+  seen = Seen();
+  host::Connection c;
+  c.receive(request);
+  CHECK(c.output.rfind(status, 0) == 0);
+  // Held open until the refusal is acked, so it isn't lost to a reset
+  CHECK(!c.closed);
+  c.receive("more");
+  CHECK(!c.closed);
+  c.ack();
+  CHECK(c.closed);
+  CHECK(seen.requests == 0);
+}
+
+int main() {
+  server.on("/echo", HTTP_GET | HTTP_POST, record).addInterestingHeader("ANY");
+  server.begin();
+
+  for (size_t piece = 1; piece <= get.size(); ++piece) check_get(piece);
+  for (size_t piece = 1; piece <= post.size(); ++piece) check_post(piece);
+
+  // Pipelined on one connection: both are answered, in order
+  {
+    seen = Seen();
+    host::Connection c;
+    c.receive(get + get);
+    c.ack();
+    c.ack();
+    CHECK(seen.requests == 2);
+    size_t first = c.output.find("HTTP/1.1 200 OK\r\n");
+    CHECK(first == 0);
+    CHECK(c.output.find("HTTP/1.1 200 OK\r\n", first + 1) != std::string::npos);
+  }
+
+  check_refused("GET /" + std::string(4096, 'a') + " HTTP/1.1\r\n\r\n", "HTTP/1.1 414 ");
+  check_refused("GET / HTTP/1.1\r\nX-Long: " + std::string(2048, 'b') + "\r\n\r\n", "HTTP/1.1 431 ");
+  check_refused("POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n;x\r\n", "HTTP/1.1 400 ");
+
+  // An unknown method gets a 501, and the connection stays usable
+  {
+    seen = Seen();
+    host::Connection c;
+    c.receive("BREW /pot HTTP/1.1\r\n\r\n" + get);
+    c.ack();
+    c.ack();
+    CHECK(c.output.rfind("HTTP/1.1 501 ", 0) == 0);
+    CHECK(c.output.find("HTTP/1.1 200 OK\r\n") != std::string::npos);
+    CHECK(seen.requests == 1);
+  }
+
+  server.end();
+  printf("test_head_parse: ok\n");
+  return 0;
+}
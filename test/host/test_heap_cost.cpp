@@ -0,0 +1,42 @@
+// Learned heap cost: memory a handler holds only while it builds its response, or only after
+// it has answered, must still be seen by the samples the request takes
+#include "host.h"
+
+static AsyncWebServer server(80);
+
+static const std::string request(const char* url) {
+  return std::string("GET ") + url + " HTTP/1.1\r\nHost: device.local\r\n\r\n";
+}
+
+int main() {
+  // Holds memory while building the response, and lets it go before returning
+  AsyncWebHandler& building = server.on("/building", HTTP_GET, [](AsyncWebServerRequest* r){
+    host::freeHeap -= 20000;
+    r->send(200, "text/plain", "ok");
+    host::freeHeap += 20000;
+  });
+  // Answers first, then takes memory it keeps after returning
+  AsyncWebHandler& keeping = server.on("/keeping", HTTP_GET, [](AsyncWebServerRequest* r){
+    r->send(200, "text/plain", "ok");
+    host::freeHeap -= 30000;
+  });
+  server.begin();
+
+  {
+    host::Connection c;
+    c.receive(request("/building"));
+    c.ack();
+    CHECK(building.learnedHeapCost() >= 20000);
+  }
+  {
+    host::Connection c;
+    c.receive(request("/keeping"));
+    host::freeHeap += 30000;   // released before the response is acked
+    c.ack();
+    CHECK(keeping.learnedHeapCost() >= 30000);
+  }
+
+  server.end();
+  printf("test_heap_cost: ok\n");
+  return 0;
+}
@@ -0,0 +1,126 @@
+// Multipart bodies: fields and uploads must come out intact wherever TCP splits the body, in
+// particular when a packet ends partway through a delimiter or through data that resembles one
+#include "host.h"
+
+static AsyncWebServer server(80);
+
+struct Seen {
+  int requests = 0;
+  String name;
+  String note;
+  String filename;
+  size_t fileSize = 0;
+  std::string upload;
+  size_t expectedIndex = 0;
+  int finals = 0;
+  bool ordered = true;
+  bool aligned = true;
+};
+static Seen seen;
+
+static void record(AsyncWebServerRequest* request) {
+  ++seen.requests;
+  seen.name = request->hasParam("name", true) ? request->getParam("name", true)->value() : String("-");
+  seen.note = request->hasParam("note", true) ? request->getParam("note", true)->value() : String("-");
+  if (request->hasParam("file", true, true)) {
+    const AsyncWebParameter* p = request->getParam("file", true, true);
+    seen.filename = p->value();
+    seen.fileSize = p->size();
+  }
+  request->send(200, "text/plain", "ok");
+}
+
+static void upload(AsyncWebServerRequest* request, const String&, size_t index, uint8_t* data, size_t len, bool final) {
+  if (index != seen.expectedIndex) seen.ordered = false;
+  // Staged uploads are handed on in whole chunks until the last
+  if ((request->url() == "/staged") && !final && (len % 64)) seen.aligned = false;
+  seen.upload.append((const char*) data, len);
+  seen.expectedIndex = index + len;
+  if (final) ++seen.finals;
+}
+
+static const std::string boundary = "----bound0123";
+
+// File contents holding near-misses of the delimiter, including one that runs to the end
+static const std::string file =
+  std::string("line one\r\n--") + "\r\n----bound012" + std::string(300, 'x') +
+  "\r\n----bound" + std::string("\0\1\2\r\n", 5) + "----bound0123 not after a line break\r\n-";
+
+static const std::string body =
+  "preamble\r\n"
+  "--" + boundary + "\r\n"
+  "Content-Disposition: form-data; name=\"name\"\r\n"
+  "\r\n"
+  "device one\r\n"
+  "--" + boundary + "\r\n"
+  "Content-Disposition: form-data; name=\"file\"; filename=\"data.bin\"\r\n"
+  "Content-Type: application/octet-stream\r\n"
+  "\r\n" + file + "\r\n"
+  "--" + boundary + "\r\n"
+  "Content-Disposition: form-data; name=\"note\"\r\n"
+  "\r\n"
+  "\r\n--not it\r\n"
+  "--" + boundary + "--\r\n"
+  "epilogue";
+
+static std::string request(const char* uri) {
+  return std::string("POST ") + uri + " HTTP/1.1\r\n"
+    "Host: device.local\r\n"
+    "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n"
+    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+    "\r\n" + body;
+}
+
+// Feeds the request split at the given offsets into the body
+static void exchange(const std::string& head, std::initializer_list<size_t> cuts) {
+  seen = Seen();
+  host::Connection c;
+  c.receive(head);
+  size_t at = 0;
+  for (size_t cut : cuts) {
+    c.receive(body.substr(at, cut - at));
+    at = cut;
+  }
+  c.receive(body.substr(at));
+  c.ack();
+  CHECK(c.output.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+  CHECK(seen.requests == 1);
+  CHECK(seen.name == "device one");
+  CHECK(seen.note == "\r\n--not it");
+  CHECK(seen.filename == "data.bin");
+  CHECK(seen.fileSize == file.size());
+  CHECK(seen.upload == file);
+  CHECK(seen.ordered);
+  CHECK(seen.aligned);
+  CHECK(seen.finals == 1);
+}
+
+int main() {
+  server.on("/upload", HTTP_POST, record, upload);
+  server.on("/staged", HTTP_POST, record, upload).setUploadChunkSize(64);
+  server.begin();
+
+  for (const char* uri : { "/upload", "/staged" }) {
+    const std::string r = request(uri);
+    const std::string head = r.substr(0, r.size() - body.size());
+    exchange(head, {});
+    for (size_t cut = 1; cut < body.size(); ++cut) exchange(head, { cut });
+    // Three packets, the middle one shorter than a delimiter
+    for (size_t cut = 1; cut + 3 < body.size(); ++cut) exchange(head, { cut, cut + 3 });
+  }
+
+  // A byte at a time
+  {
+    seen = Seen();
+    host::Connection c;
+    for (char ch : request("/staged")) c.receive(&ch, 1);
+    c.ack();
+    CHECK(seen.requests == 1);
+    CHECK(seen.upload == file);
+    CHECK(seen.ordered);
+  }
+
+  server.end();
+  printf("test_multipart: ok\n");
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Offloaded handlers: the response goes out as soon as the worker is done, a client that leaves
+// meanwhile outlives the worker's use of it, and destroying the server lets go of what the
+// workers still had
+#include "host.h"
+#include <thread>
+
+static std::atomic<bool> release(false);
+static std::atomic<bool> entered(false);
+static std::atomic<bool> returned(false);
+static std::chrono::steady_clock::time_point returnedAt;
+
+// Takes a while on the worker, looking at its client as it goes
+static void slow(AsyncWebServerRequest* request) {
+  entered = true;
+  while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  IPAddress remote = request->client()->remoteIP();
+  request->send(200, "text/plain", remote.toString());
+  returnedAt = std::chrono::steady_clock::now();
+  returned = true;
+}
+
+static std::string get(const char* url) {
+  return std::string("GET ") + url + " HTTP/1.1\r\nHost: device.local\r\n\r\n";
+}
+
+static void reset() {
+  release = entered = returned = false;
+}
+
+int main() {
+  {
+    AsyncWebServer server(80);
+    server.on("/slow", HTTP_GET, slow).setOffload();
+    server.begin();
+
+    // Sent without waiting for the connection to be polled or acked
+    {
+      reset();
+      host::Connection c;
+      c.receive(get("/slow"));
+      CHECK(c.output.empty());
+      release = true;
+      CHECK(host::run([&]{ return !c.output.empty(); }, std::chrono::milliseconds(2000)));
+      auto latency = std::chrono::steady_clock::now() - returnedAt;
+      CHECK(returned);
+      CHECK(latency < std::chrono::milliseconds(50));
+      CHECK(c.output.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+      c.ack();
+    }
+
+    // The client disconnects while the handler runs: it is kept until the request is collected
+    {
+      reset();
+      host::Connection other;   // carries the wake, as the orphan's own connection is gone
+      host::Connection c;
+      c.receive(get("/slow"));
+      CHECK(host::run([]{ return entered.load(); }, std::chrono::milliseconds(2000)));
+      c.disconnect();
+      CHECK(c.client != nullptr);
+      release = true;
+      CHECK(host::run([&]{ return c.client == nullptr; }, std::chrono::milliseconds(2000)));
+      CHECK(returned);
+    }
+
+    server.end();
+  }
+
+  // Destroyed with one handler running and one waiting for the worker: both requests and their
+  // clients are freed (the leak checker sees to the rest)
+  {
+    reset();
+    auto server = new AsyncWebServer(80);
+    server->on("/slow", HTTP_GET, slow).setOffload();
+    server->begin();
+    host::Connection running, waiting;
+    running.receive(get("/slow"));
+    CHECK(host::run([]{ return entered.load(); }, std::chrono::milliseconds(2000)));
+    waiting.receive(get("/slow"));
+    std::thread later([]{
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      release = true;
+    });
+    delete server;
+    later.join();
+    CHECK(running.client == nullptr);
+    CHECK(waiting.client == nullptr);
+  }
+
+  printf("test_offload: ok\n");
+  return 0;
+}
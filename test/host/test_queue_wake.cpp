@@ -0,0 +1,65 @@
+// Passes asked for off the network task, by the backstop timer or by the sketch, must run
+// promptly on the network task without waiting for a connection to be polled or acked
+#include "host.h"
+#include <thread>
+
+static AsyncWebServer server(80);
+
+static AsyncWebServerRequest* holding = nullptr;
+static int waiting = 0;
+
+static std::string get(const char* url) {
+  return std::string("GET ") + url + " HTTP/1.1\r\nHost: device.local\r\n\r\n";
+}
+
+// Starts a held request, then queues another behind it for want of heap
+static void queue_behind(host::Connection& first, host::Connection& second) {
+  holding = nullptr;
+  waiting = 0;
+  first.receive(get("/hold"));
+  CHECK(holding);
+  host::freeHeap = 40 * 1024;
+  second.receive(get("/wait"));
+  CHECK(waiting == 0);
+}
+
+int main() {
+  server.on("/hold", HTTP_GET, [](AsyncWebServerRequest* r){ holding = r; });
+  server.on("/wait", HTTP_GET, [](AsyncWebServerRequest* r){ ++waiting; r->send(204); });
+  AsyncWebServerQueueLimits limits = { 0, 0, 0, 64 * 1024 };
+  server.setQueueLimits(limits);
+  server.begin();
+
+  // Heap freed with nobody saying so: the backstop timer starts the waiting request
+  {
+    host::Connection first, second;
+    queue_behind(first, second);
+    host::freeHeap = 160 * 1024;
+    CHECK(host::run([]{ return waiting == 1; }, std::chrono::milliseconds(2000)));
+    holding->send(204);
+    first.ack();
+    second.ack();
+  }
+
+  // Heap freed by another task, which says so: started well before the backstop is due
+  {
+    host::Connection first, second;
+    queue_behind(first, second);
+    auto freed = std::chrono::steady_clock::now();
+    std::thread sketch([&]{
+      host::freeHeap = 160 * 1024;
+      server.notifyResourcesFreed();
+    });
+    CHECK(host::run([]{ return waiting == 1; }, std::chrono::milliseconds(2000)));
+    auto latency = std::chrono::steady_clock::now() - freed;
+    sketch.join();
+    CHECK(latency < std::chrono::milliseconds(60));
+    holding->send(204);
+    first.ack();
+    second.ack();
+  }
+
+  server.end();
+  printf("test_queue_wake: ok\n");
+  return 0;
+}